@@ -9,9 +9,11 @@
 #include <avr/eeprom.h>       // for accessing data in eeprom
 #include <avr/power.h>        // for enabling/disabling microcontroller modules
 #include <util/delay_basic.h> // for the _delay_loop_1() macro
+#include <util/atomic.h>      // for non-interruptable blocks
 
 
 #include "alarm.h"
+#include "profile.h"  // for profiling atomic blocks
 #include "piezo.h"   // for sounding the alarm
 #include "time.h"    // alarm must sound at appropriate time
 #include "system.h"  // alarm behavior depends on power source
@@ -24,7 +26,7 @@
 volatile alarm_t alarm;
 
 
-// default alarm times
+// default alarm times, sorted by time of day
 uint8_t ee_alarm_hours[ALARM_COUNT] EEMEM = {
     [0 ... ALARM_COUNT - 1] = ALARM_DEFAULT_HOUR
 };
@@ -46,10 +48,28 @@ uint8_t ee_alarm_volume_max  EEMEM = ALARM_DEFAULT_VOLUME_MAX;
 uint8_t ee_alarm_ramp_time   EEMEM = ALARM_DEFAULT_RAMP_TIME;
 
 
+// private function declarations
+uint16_t alarm_timeofday(uint8_t idx);
+void alarm_swap(uint8_t idx);
+void alarm_copy(uint8_t src, uint8_t dst);
+void alarm_findnext(uint8_t idx);
+uint8_t alarm_search(time_snap_t* snap, uint8_t* idx);
+int32_t alarm_until(const time_snap_t* now);
+uint16_t alarm_datekey(const time_snap_t* snap);
+uint32_t alarm_secondofday(const time_snap_t* snap);
+void alarm_nextday(time_snap_t* snap);
+
+
 // initialize alarm after system reset
 void alarm_init(void) {
-    // load alarms
-    for(uint8_t i = 0; i < ALARM_COUNT; ++i) alarm_loadalarm(i);
+    // sort alarms by time of day, in case eeprom contains alarms
+    // saved by an older firmware version
+    for(uint8_t i = 1; i < ALARM_COUNT; ++i) {
+	for(uint8_t j = i; j && alarm_timeofday(j - 1) > alarm_timeofday(j);
+		--j) {
+	    alarm_swap(j - 1);
+	}
+    }
 
     // load alarm configuration and ensure reasonable values
     alarm.status       = eeprom_read_byte(&ee_alarm_status)
@@ -75,6 +95,9 @@ void alarm_init(void) {
     // calculate time.ramp_int
     alarm_newramp();
 
+    // find next alarm time
+    alarm_newtime();
+
     // configure pins for low-power mode
     alarm_sleep();
 }
@@ -95,7 +118,7 @@ void alarm_wake(void) {
     } else {
 	if(alarm.status & ALARM_SOUNDING) piezo_alarm_stop();
 	alarm.status &= ~ALARM_SET & ~ALARM_SOUNDING & ~ALARM_SNOOZE;
-	display.status &= ~DISPLAY_PULSING;
+	HOTFLAG_CLEAR(DISPLAY_PULSING);
 	display_autodim();
     }
 
@@ -129,16 +152,14 @@ void alarm_tick(void) {
     // will be set to TRUE if alarm should be triggered
     uint8_t is_alarm_trigger = FALSE;
     
-    // check if alarm time is now
-    for(uint8_t i = 0; i < ALARM_COUNT; ++i) {
-	if((alarm.days[i] & ALARM_ENABLED)
-		&& time.hour == alarm.hours[i]
-		&& time.minute == alarm.minutes[i]
-		&& time.second == 0
-		&& (alarm.days[i] & _BV(time_dayofweek(time.year, time.month,
-			    			       time.day)))) {
-	    is_alarm_trigger = TRUE;
-	}
+    // check if alarm time has been reached
+    time_snap_t now;
+    time_snapshot(&now);
+    if(alarm_until(&now) <= 0) {
+	is_alarm_trigger = TRUE;
+
+	// advance to following alarm
+	alarm_findnext(alarm.next_idx + 1);
     }
 
     // check if snooze period is over
@@ -148,7 +169,7 @@ void alarm_tick(void) {
     }
 
     // during sleep, briefly wake alarm to query alarm switch as necessary
-    if(system.status & SYSTEM_SLEEP
+    if(HOTFLAG_TEST(SYSTEM_SLEEP)
 	    && (is_alarm_trigger || alarm.status & ALARM_SOUNDING)) {
 	alarm_wake();
 	alarm_sleep();
@@ -161,13 +182,13 @@ void alarm_tick(void) {
 	alarm.status |= ALARM_SOUNDING;
 
 	if(alarm.status & ALARM_SOUNDING_PULSE) {
-	    display.status |= DISPLAY_PULSING;
+	    HOTFLAG_SET(DISPLAY_PULSING);
 	} else {
-	    display.status &= ~DISPLAY_PULSING;
+	    HOTFLAG_CLEAR(DISPLAY_PULSING);
 	    display_autodim();
 	}
 
-	if(system.status & SYSTEM_SLEEP) {
+	if(HOTFLAG_TEST(SYSTEM_SLEEP)) {
 	    // wake user immediately to reduce alarm time,
 	    // save power, and extend coin battery life
 	    alarm.volume = alarm.volume_max;
@@ -197,7 +218,7 @@ void alarm_tick(void) {
 	} else if(alarm.alarm_timer > ALARM_SOUNDING_TIMEOUT) {
 	    // silence alarm on alarm timeout
 	    alarm.status &= ~ALARM_SOUNDING;
-	    display.status &= ~DISPLAY_PULSING;
+	    HOTFLAG_CLEAR(DISPLAY_PULSING);
 	    display_autodim();
 	    piezo_alarm_stop();
 	}
@@ -227,7 +248,7 @@ void alarm_semitick(void) {
 	    if(++alarm_debounce >= ALARM_DEBOUNCE_TIME) {
 		if(alarm.status & ALARM_SOUNDING) piezo_alarm_stop();
 		alarm.status &= ~ALARM_SET & ~ALARM_SOUNDING & ~ALARM_SNOOZE;
-		display.status &= ~DISPLAY_PULSING;
+		HOTFLAG_CLEAR(DISPLAY_PULSING);
 		display_autodim();
 		mode_alarmoff();
 		display_onbutton();
@@ -241,16 +262,89 @@ void alarm_semitick(void) {
 
 // load alarm number idx from eeprom
 void alarm_loadalarm(uint8_t idx) {
-    alarm.hours[idx]   = eeprom_read_byte(&(ee_alarm_hours[idx]))   % 24;
-    alarm.minutes[idx] = eeprom_read_byte(&(ee_alarm_minutes[idx])) % 60;
-    alarm.days[idx]    = eeprom_read_byte(&(ee_alarm_days[idx]));
+    alarm.hour   = eeprom_read_byte(&(ee_alarm_hours[idx]))   % 24;
+    alarm.minute = eeprom_read_byte(&(ee_alarm_minutes[idx])) % 60;
+    alarm.days   = eeprom_read_byte(&(ee_alarm_days[idx]));
 }
 
-// save alarm number idx to eeprom
+
+// load first enabled alarm with index idx or greater from eeprom;
+// returns its index or ALARM_COUNT if there is no such alarm
+uint8_t alarm_loadenabled(uint8_t idx) {
+    for(; idx < ALARM_COUNT; ++idx) {
+	if(eeprom_read_byte(&(ee_alarm_days[idx])) & ALARM_ENABLED) {
+	    alarm_loadalarm(idx);
+	    break;
+	}
+    }
+
+    return idx;
+}
+
+
+// save alarm to eeprom as alarm number idx, moving it as necessary
+// to keep alarms sorted by time of day; alarms between its old and
+// new position shift by one, so each alarm is written at most once
 void alarm_savealarm(uint8_t idx) {
-    eeprom_write_byte(&(ee_alarm_hours[idx]), alarm.hours[idx]);
-    eeprom_write_byte(&(ee_alarm_minutes[idx]), alarm.minutes[idx]);
-    eeprom_write_byte(&(ee_alarm_days[idx]), alarm.days[idx]);
+    uint16_t tod = alarm.hour % 24;
+    tod *= 60;  // hours to minutes
+    tod += alarm.minute % 60;
+
+    while(idx && alarm_timeofday(idx - 1) > tod) {
+	alarm_copy(idx - 1, idx);
+	--idx;
+    }
+
+    while(idx < ALARM_COUNT - 1 && alarm_timeofday(idx + 1) < tod) {
+	alarm_copy(idx + 1, idx);
+	++idx;
+    }
+
+    eeprom_update_byte(&(ee_alarm_hours[idx]), alarm.hour);
+    eeprom_update_byte(&(ee_alarm_minutes[idx]), alarm.minute);
+    eeprom_update_byte(&(ee_alarm_days[idx]), alarm.days);
+
+    alarm_newtime();
+}
+
+
+// returns time of day of alarm number idx in eeprom
+// (minutes past midnight)
+uint16_t alarm_timeofday(uint8_t idx) {
+    uint16_t tod = eeprom_read_byte(&(ee_alarm_hours[idx])) % 24;
+    tod *= 60;  // hours to minutes
+    tod += eeprom_read_byte(&(ee_alarm_minutes[idx])) % 60;
+    return tod;
+}
+
+
+// swap alarm numbers idx and idx + 1 in eeprom
+void alarm_swap(uint8_t idx) {
+    uint8_t hour   = eeprom_read_byte(&(ee_alarm_hours[idx]));
+    uint8_t minute = eeprom_read_byte(&(ee_alarm_minutes[idx]));
+    uint8_t days   = eeprom_read_byte(&(ee_alarm_days[idx]));
+
+    eeprom_write_byte(&(ee_alarm_hours[idx]),
+		      eeprom_read_byte(&(ee_alarm_hours[idx + 1])));
+    eeprom_write_byte(&(ee_alarm_minutes[idx]),
+		      eeprom_read_byte(&(ee_alarm_minutes[idx + 1])));
+    eeprom_write_byte(&(ee_alarm_days[idx]),
+		      eeprom_read_byte(&(ee_alarm_days[idx + 1])));
+
+    eeprom_write_byte(&(ee_alarm_hours[idx + 1]),   hour);
+    eeprom_write_byte(&(ee_alarm_minutes[idx + 1]), minute);
+    eeprom_write_byte(&(ee_alarm_days[idx + 1]),    days);
+}
+
+
+// copy alarm number src to alarm number dst in eeprom
+void alarm_copy(uint8_t src, uint8_t dst) {
+    eeprom_update_byte(&(ee_alarm_hours[dst]),
+		       eeprom_read_byte(&(ee_alarm_hours[src])));
+    eeprom_update_byte(&(ee_alarm_minutes[dst]),
+		       eeprom_read_byte(&(ee_alarm_minutes[src])));
+    eeprom_update_byte(&(ee_alarm_days[dst]),
+		       eeprom_read_byte(&(ee_alarm_days[src])));
 }
 
 
@@ -295,9 +389,9 @@ uint8_t alarm_onbutton(void) {
 	alarm.status |=  ALARM_SNOOZE;
 	alarm.alarm_timer = 0;
 	if(alarm.status & ALARM_SNOOZING_PULSE) {
-	    display.status |=  DISPLAY_PULSING;
+	    HOTFLAG_SET(DISPLAY_PULSING);
 	} else {
-	    display.status &= ~DISPLAY_PULSING;
+	    HOTFLAG_CLEAR(DISPLAY_PULSING);
 	    display_autodim();
 	}
 	piezo_alarm_stop();
@@ -314,30 +408,162 @@ uint8_t alarm_onbutton(void) {
 }
 
 
-// returns true if current time is within two seconds of alarm time
-uint8_t alarm_nearalarm(void) {
-    for(uint8_t i = 0; i < ALARM_COUNT; ++i) {
-	int8_t delta_hour   = alarm.hours[i]   - time.hour;
-	int8_t delta_minute = alarm.minutes[i] - time.minute;
-	int8_t delta_second = 0                - time.second;
-
-	int32_t time_diff = delta_hour;
-	time_diff *= 60;  // hours to minutes
-	time_diff += delta_minute;
-	time_diff *= 60;  // minutes to seconds
-	time_diff += delta_second;
-
-	if(time_diff > (int32_t)12 * 60 * 60) {
-	    time_diff -= (int32_t)24 * 60 * 60;
-	} else if(time_diff < (int32_t)-12 * 60 * 60) {
-	    time_diff += (int32_t)24 * 60 * 60;
+// find the time of the next enabled alarm;
+// must be called whenever the alarms, time, or date change
+void alarm_newtime(void) {
+    uint16_t now = time.hour;
+    now *= 60;  // hours to minutes
+    now += time.minute;
+
+    // binary search for first alarm at or after the current minute
+    uint8_t lo = 0, hi = ALARM_COUNT;
+    while(lo < hi) {
+	uint8_t mid = (lo + hi) >> 1;
+	if(alarm_timeofday(mid) < now) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
 	}
+    }
 
-	if(-ALARM_NEAR_THRESHOLD <= time_diff
-		&& time_diff <= ALARM_NEAR_THRESHOLD) {
-	    return TRUE;
+    alarm_findnext(lo);
+}
+
+
+// find the next enabled alarm, starting with alarm number idx
+// today and continuing with alarm number zero on following days
+void alarm_findnext(uint8_t idx) {
+    uint8_t done = FALSE;
+
+    // the search reads eeprom, so it runs on a snapshot of the time
+    // with interrupts enabled and is repeated if the time changes
+    while(!done) {
+	time_snap_t snap;
+	uint8_t seq = time_snapshot(&snap);
+
+	uint8_t  next_idx    = idx;
+	uint16_t next_date   = ALARM_NONE;
+	uint32_t next_second = 0;
+	if(alarm_search(&snap, &next_idx)) {
+	    next_date   = alarm_datekey(&snap);
+	    next_second = alarm_secondofday(&snap);
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	    if(seq == time.seq) {
+		alarm.next_idx    = next_idx;
+		alarm.next_date   = next_date;
+		alarm.next_second = next_second;
+		done = TRUE;
+	    }
+	}
+    }
+}
+
+
+// finds alarm number *idx or the next enabled alarm after it
+// which sounds after the time in *snap; stores the alarm number
+// in *idx and the alarm time in *snap and returns TRUE, or returns
+// FALSE if no alarms are enabled
+uint8_t alarm_search(time_snap_t* snap, uint8_t* idx) {
+    uint8_t day = time_dayofweek(snap->year, snap->month, snap->day);
+    uint8_t i   = *idx;
+
+    uint16_t now = snap->hour;
+    now *= 60;  // hours to minutes
+    now += snap->minute;
+
+    // alarms are sorted, so the first enabled alarm found after
+    // the current minute is the next alarm; search up to one
+    // week from now in case an alarm is enabled for today only
+    for(uint8_t d = 0; d <= 7; ++d) {
+	for(; i < ALARM_COUNT; ++i) {
+	    uint8_t days = eeprom_read_byte(&(ee_alarm_days[i]));
+	    if(!(days & ALARM_ENABLED) || !(days & _BV(day))) continue;
+
+	    uint16_t tod = alarm_timeofday(i);
+	    if(d || tod > now) {
+		*idx = i;
+		snap->hour   = tod / 60;
+		snap->minute = tod % 60;
+		snap->second = 0;
+		return TRUE;
+	    }
 	}
+
+	i = 0;
+	if(++day > TIME_SAT) day = TIME_SUN;
+	alarm_nextday(snap);
     }
 
     return FALSE;
 }
+
+
+// returns the number of seconds from the given time until the next
+// alarm, zero or less once it has been reached, or ALARM_FAR if the
+// alarm is more than a day away or no alarms are enabled
+int32_t alarm_until(const time_snap_t* now) {
+    int32_t until = alarm.next_second;
+    until -= alarm_secondofday(now);
+
+    uint16_t today = alarm_datekey(now);
+    if(alarm.next_date == today) return until;
+    if(alarm.next_date < today)  return 0;
+
+    time_snap_t tomorrow = *now;
+    alarm_nextday(&tomorrow);
+    if(alarm.next_date == alarm_datekey(&tomorrow)) {
+	return until + (int32_t)24 * 60 * 60;
+    }
+
+    return ALARM_FAR;
+}
+
+
+// returns a key which orders dates; keys of consecutive
+// days are not consecutive, so it is no count of days
+uint16_t alarm_datekey(const time_snap_t* snap) {
+    uint16_t key = snap->year;
+    key <<= 4;
+    key |= snap->month;
+    key <<= 5;
+    key |= snap->day;
+    return key;
+}
+
+
+// returns the seconds past midnight of the given time
+uint32_t alarm_secondofday(const time_snap_t* snap) {
+    uint32_t sod = snap->hour;
+    sod *= 60;  // hours to minutes
+    sod += snap->minute;
+    sod *= 60;  // minutes to seconds
+    sod += snap->second;
+    return sod;
+}
+
+
+// advances the date of the given time by one day
+void alarm_nextday(time_snap_t* snap) {
+    if(++snap->day > time_daysinmonth(snap->year, snap->month)) {
+	snap->day = 1;
+	if(++snap->month > 12) {
+	    snap->month = 1;
+	    ++snap->year;
+	}
+    }
+}
+
+
+// returns true if current time is within a few seconds of alarm time
+uint8_t alarm_nearalarm(void) {
+    // an alarm is about to sound, or an alarm has just sounded
+    time_snap_t now;
+    time_snapshot(&now);
+    int32_t until = alarm_until(&now);
+
+    return (until > 0 && until <= ALARM_NEAR_THRESHOLD)
+	   || (alarm.status & ALARM_SOUNDING
+	       && alarm.alarm_timer <= ALARM_NEAR_THRESHOLD);
+}
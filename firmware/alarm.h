@@ -8,7 +8,16 @@
 
 
 // number of alarms to set
+#ifndef ALARM_COUNT
 #define ALARM_COUNT 3
+#endif  // ~ALARM_COUNT
+
+// alarms are saved from a semitick, which must not stall on
+// hundreds of eeprom writes; alarm numbers are also shown with
+// two digits
+#if ALARM_COUNT > 99
+#error ALARM_COUNT must not exceed 99
+#endif  // ALARM_COUNT > 99
 
 // alarm triggers at 10:00 am
 #define ALARM_DEFAULT_HOUR   10  // (hours past midnight)
@@ -35,6 +44,12 @@
 // maximum allowed time difference for alarm_nearalarm()
 #define ALARM_NEAR_THRESHOLD 5  // seconds
 
+// value of alarm.next_date when no alarm is enabled
+#define ALARM_NONE UINT16_MAX
+
+// alarm_until() value for alarms more than a day away
+#define ALARM_FAR INT32_MAX
+
 
 // flags for alarm.status
 #define ALARM_SET      0x01
@@ -55,9 +70,17 @@ typedef struct {
     uint16_t snooze_time;  // duration of snooze in seconds
     uint16_t alarm_timer;  // time in current state (sounding or snooze)
 
-    uint8_t  hours[ALARM_COUNT];    // hour for alarms
-    uint8_t  minutes[ALARM_COUNT];  // minute for alarms
-    uint8_t  days[ALARM_COUNT];     // day-of-week for alarms
+    // alarm being displayed or set (see alarm_loadalarm()); all
+    // alarms are kept in eeprom, sorted by time of day
+    uint8_t  hour;         // hour for alarm
+    uint8_t  minute;       // minute for alarm
+    uint8_t  days;         // day-of-week for alarm
+
+    // time of next enabled alarm; compared with the current time
+    // on every tick, so missed or late ticks cannot shift it
+    uint8_t  next_idx;     // index of next enabled alarm
+    uint16_t next_date;    // date key (see alarm_datekey())
+    uint32_t next_second;  // seconds past midnight
 
     uint8_t  volume;       // current progressive alarm volume
     uint8_t  volume_min;   // minimum sound volume of buzzer
@@ -81,6 +104,7 @@ void alarm_semitick(void);
 
 void alarm_savealarm(uint8_t idx);
 void alarm_loadalarm(uint8_t idx);
+uint8_t alarm_loadenabled(uint8_t idx);
 void alarm_savevolume(void);
 void alarm_saveramp(void);
 void alarm_newramp(void);
@@ -89,6 +113,7 @@ void alarm_savestatus(void);
 
 uint8_t alarm_onbutton(void);
 
+void alarm_newtime(void);
 uint8_t alarm_nearalarm(void);
 
 #endif
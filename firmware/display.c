@@ -28,6 +28,7 @@
 
 
 #include <avr/io.h>       // for using avr register names
+#include <avr/interrupt.h> // for defining adc interrupt
 #include <avr/pgmspace.h> // for accessing data in program memory
 #include <avr/eeprom.h>   // for accessing data in eeprom memory
 #include <avr/power.h>    // for enabling/disabling chip features
@@ -36,13 +37,28 @@
 
 
 #include "display.h"
+#include "profile.h"  // for profiling atomic blocks
 #include "usart.h"    // for debugging output
 #include "system.h"   // for determining system status
 #include "time.h"     // for determing current time
+#include "timer.h"    // for display-off timer
 
 
 // extern'ed data pertaining the display
 volatile display_t display;
+display_frame_t display_frames[2];
+
+
+// private function declarations
+static void display_animstart(uint8_t track, uint16_t delay);
+
+
+#ifdef ADAPTIVE_MULTIPLEX_RATE
+// display may multiplex slowly once display-off timer expires
+#define DISPLAY_OFF_CALLBACK display_noflicker
+#else
+#define DISPLAY_OFF_CALLBACK 0
+#endif  // ADAPTIVE_MULTIPLEX_RATE
 
 
 // permanent place to store display brightness
@@ -69,6 +85,14 @@ uint8_t ee_display_off_days EEMEM = 0;
 uint8_t ee_display_on_days  EEMEM = 0;
 
 
+#ifdef VFD_TO_SPEC
+// filament pin levels for each waveform step
+const uint8_t display_filament[FILAMENT_STEPS] PROGMEM = {
+    FILAMENT_WAVEFORM
+};
+#endif  // VFD_TO_SPEC
+
+
 // display of letters and numbers is coded by 
 // the appropriate segment flags:
 #define SEG_A 0x80  //
@@ -86,8 +110,79 @@ uint8_t ee_display_on_days  EEMEM = 0;
 #define DISPLAY_SLASH    SEG_B | SEG_G | SEG_E
 #define DISPLAY_WILDCARD SEG_A | SEG_G | SEG_D
 
-// codes for vfd letter display
-const uint8_t letter_segments_ada[] PROGMEM = {
+// fonts cover printable ascii characters (space through delete)
+#define DISPLAY_FONT_FIRST ' '
+#define DISPLAY_FONT_SIZE  96
+
+// segment codes for printable ascii characters, indexed by character
+// code minus DISPLAY_FONT_FIRST; both fonts share all but the letters
+// and show either case of a letter with the same segments
+const uint8_t display_font_ada[DISPLAY_FONT_SIZE] PROGMEM = {
+    DISPLAY_SPACE,                                 // space
+    SEG_B | SEG_C | SEG_H,                         // !
+    SEG_B | SEG_F,                                 // "
+    SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G, // #
+    SEG_A | SEG_C | SEG_D | SEG_F | SEG_G | SEG_H, // $
+    SEG_B | SEG_E | SEG_G | SEG_H,                 // %
+    SEG_B | SEG_C | SEG_G,                         // &
+    SEG_F,                                         // '
+    SEG_A | SEG_D | SEG_E | SEG_F,                 // (
+    SEG_A | SEG_B | SEG_C | SEG_D,                 // )
+    SEG_A | SEG_B | SEG_F | SEG_G,                 // *
+    SEG_E | SEG_F | SEG_G,                         // +
+    SEG_E,                                         // ,
+    DISPLAY_DASH,                                  // -
+    DISPLAY_DOT,                                   // .
+    DISPLAY_SLASH,                                 // /
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F, // 0
+    SEG_B | SEG_C,                                 // 1
+    SEG_A | SEG_B | SEG_D | SEG_E | SEG_G,         // 2
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,         // 3
+    SEG_B | SEG_C | SEG_F | SEG_G,                 // 4
+    SEG_A | SEG_C | SEG_D | SEG_F | SEG_G,         // 5
+    SEG_A | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G, // 6
+    SEG_A | SEG_B | SEG_C,                         // 7
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,// 8
+    SEG_A | SEG_B | SEG_C | SEG_F | SEG_G,         // 9
+    SEG_A | SEG_D,                                 // : (colons use colon_frame)
+    SEG_A | SEG_C | SEG_D,                         // ;
+    SEG_A | SEG_F | SEG_G,                         // <
+    SEG_D | SEG_G,                                 // =
+    SEG_A | SEG_B | SEG_G,                         // >
+    SEG_A | SEG_B | SEG_E | SEG_G | SEG_H,         // ?
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_G, // @
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_G, // A
+    SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,         // B
+    SEG_D | SEG_E | SEG_G,                         // C
+    SEG_B | SEG_C | SEG_D | SEG_E | SEG_G,         // D
+    SEG_A | SEG_B | SEG_D | SEG_E | SEG_F | SEG_G, // E
+    SEG_A | SEG_E | SEG_F | SEG_G,                 // F
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_F | SEG_G, // G
+    SEG_C | SEG_E | SEG_F | SEG_G,                 // H
+    SEG_B | SEG_C,                                 // I
+    SEG_B | SEG_C | SEG_D | SEG_E,                 // J
+    SEG_A | SEG_C | SEG_E | SEG_F | SEG_G,         // K
+    SEG_D | SEG_E | SEG_F,                         // L
+    SEG_A | SEG_C | SEG_E | SEG_G,                 // M
+    SEG_C | SEG_E | SEG_G,                         // N
+    SEG_C | SEG_D | SEG_E | SEG_G,                 // O
+    SEG_A | SEG_B | SEG_E | SEG_F | SEG_G,         // P
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,         // Q
+    SEG_E | SEG_G,                                 // R
+    SEG_A | SEG_C | SEG_D | SEG_F | SEG_G,         // S
+    SEG_D | SEG_E | SEG_F | SEG_G,                 // T
+    SEG_C | SEG_D | SEG_E,                         // U
+    SEG_C | SEG_D | SEG_E,                         // V
+    SEG_A | SEG_C | SEG_D | SEG_E,                 // W
+    SEG_B | SEG_C | SEG_E | SEG_F | SEG_G,         // X
+    SEG_B | SEG_C | SEG_D | SEG_F | SEG_G,         // Y
+    SEG_A | SEG_B | SEG_D | SEG_E | SEG_G,         // Z
+    SEG_A | SEG_D | SEG_E | SEG_F,                 // [
+    SEG_C | SEG_F | SEG_G,                         // backslash
+    SEG_A | SEG_B | SEG_C | SEG_D,                 // ]
+    SEG_A | SEG_B | SEG_F,                         // ^
+    SEG_D,                                         // _
+    SEG_B,                                         // `
     SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_G, // a
     SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,         // b
     SEG_D | SEG_E | SEG_G,                         // c
@@ -114,15 +209,53 @@ const uint8_t letter_segments_ada[] PROGMEM = {
     SEG_B | SEG_C | SEG_E | SEG_F | SEG_G,         // x
     SEG_B | SEG_C | SEG_D | SEG_F | SEG_G,         // y
     SEG_A | SEG_B | SEG_D | SEG_E | SEG_G,         // z
+    SEG_B | SEG_C | SEG_G,                         // {
+    SEG_E | SEG_F,                                 // |
+    SEG_E | SEG_F | SEG_G,                         // }
+    SEG_A,                                         // ~
+    DISPLAY_WILDCARD,                              // delete
 };
 
 
-// alternative codes for vfd letter display
-const uint8_t letter_segments_alt[] PROGMEM = {
+// alternative segment codes for printable ascii characters
+const uint8_t display_font_alt[DISPLAY_FONT_SIZE] PROGMEM = {
+    DISPLAY_SPACE,                                 // space
+    SEG_B | SEG_C | SEG_H,                         // !
+    SEG_B | SEG_F,                                 // "
+    SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G, // #
+    SEG_A | SEG_C | SEG_D | SEG_F | SEG_G | SEG_H, // $
+    SEG_B | SEG_E | SEG_G | SEG_H,                 // %
+    SEG_B | SEG_C | SEG_G,                         // &
+    SEG_F,                                         // '
+    SEG_A | SEG_D | SEG_E | SEG_F,                 // (
+    SEG_A | SEG_B | SEG_C | SEG_D,                 // )
+    SEG_A | SEG_B | SEG_F | SEG_G,                 // *
+    SEG_E | SEG_F | SEG_G,                         // +
+    SEG_E,                                         // ,
+    DISPLAY_DASH,                                  // -
+    DISPLAY_DOT,                                   // .
+    DISPLAY_SLASH,                                 // /
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F, // 0
+    SEG_B | SEG_C,                                 // 1
+    SEG_A | SEG_B | SEG_D | SEG_E | SEG_G,         // 2
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,         // 3
+    SEG_B | SEG_C | SEG_F | SEG_G,                 // 4
+    SEG_A | SEG_C | SEG_D | SEG_F | SEG_G,         // 5
+    SEG_A | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G, // 6
+    SEG_A | SEG_B | SEG_C,                         // 7
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,// 8
+    SEG_A | SEG_B | SEG_C | SEG_F | SEG_G,         // 9
+    SEG_A | SEG_D,                                 // : (colons use colon_frame)
+    SEG_A | SEG_C | SEG_D,                         // ;
+    SEG_A | SEG_F | SEG_G,                         // <
+    SEG_D | SEG_G,                                 // =
+    SEG_A | SEG_B | SEG_G,                         // >
+    SEG_A | SEG_B | SEG_E | SEG_G | SEG_H,         // ?
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_G, // @
     SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G, // A
-    SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,         // b
+    SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,         // B
     SEG_A | SEG_D | SEG_E | SEG_F,                 // C
-    SEG_B | SEG_C | SEG_D | SEG_E | SEG_G,         // d
+    SEG_B | SEG_C | SEG_D | SEG_E | SEG_G,         // D
     SEG_A | SEG_D | SEG_E | SEG_F | SEG_G,         // E
     SEG_A | SEG_E | SEG_F | SEG_G,                 // F
     SEG_A | SEG_C | SEG_D | SEG_E | SEG_F,         // G
@@ -132,19 +265,56 @@ const uint8_t letter_segments_alt[] PROGMEM = {
     SEG_A | SEG_C | SEG_E | SEG_F | SEG_G,         // K
     SEG_D | SEG_E | SEG_F,                         // L
     SEG_A | SEG_C | SEG_E | SEG_G,                 // M
-    SEG_C | SEG_E | SEG_G,                         // n
+    SEG_C | SEG_E | SEG_G,                         // N
     SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F, // O
     SEG_A | SEG_B | SEG_E | SEG_F | SEG_G,         // P
-    SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,         // q
-    SEG_E | SEG_G,                                 // r
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,         // Q
+    SEG_E | SEG_G,                                 // R
     SEG_A | SEG_C | SEG_D | SEG_F | SEG_G,         // S
-    SEG_D | SEG_E | SEG_F | SEG_G,                 // t
+    SEG_D | SEG_E | SEG_F | SEG_G,                 // T
     SEG_B | SEG_C | SEG_D | SEG_E | SEG_F,         // U
     SEG_B | SEG_C | SEG_D | SEG_E | SEG_F,         // V
     SEG_A | SEG_C | SEG_D | SEG_E,                 // W
     SEG_B | SEG_C | SEG_E | SEG_F | SEG_G,         // X
-    SEG_B | SEG_C | SEG_D | SEG_F | SEG_G,         // y
+    SEG_B | SEG_C | SEG_D | SEG_F | SEG_G,         // Y
     SEG_A | SEG_B | SEG_D | SEG_E | SEG_G,         // Z
+    SEG_A | SEG_D | SEG_E | SEG_F,                 // [
+    SEG_C | SEG_F | SEG_G,                         // backslash
+    SEG_A | SEG_B | SEG_C | SEG_D,                 // ]
+    SEG_A | SEG_B | SEG_F,                         // ^
+    SEG_D,                                         // _
+    SEG_B,                                         // `
+    SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G, // a
+    SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,         // b
+    SEG_A | SEG_D | SEG_E | SEG_F,                 // c
+    SEG_B | SEG_C | SEG_D | SEG_E | SEG_G,         // d
+    SEG_A | SEG_D | SEG_E | SEG_F | SEG_G,         // e
+    SEG_A | SEG_E | SEG_F | SEG_G,                 // f
+    SEG_A | SEG_C | SEG_D | SEG_E | SEG_F,         // g
+    SEG_B | SEG_C | SEG_E | SEG_F | SEG_G,         // h
+    SEG_B | SEG_C,                                 // i
+    SEG_B | SEG_C | SEG_D | SEG_E,                 // j
+    SEG_A | SEG_C | SEG_E | SEG_F | SEG_G,         // k
+    SEG_D | SEG_E | SEG_F,                         // l
+    SEG_A | SEG_C | SEG_E | SEG_G,                 // m
+    SEG_C | SEG_E | SEG_G,                         // n
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F, // o
+    SEG_A | SEG_B | SEG_E | SEG_F | SEG_G,         // p
+    SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,         // q
+    SEG_E | SEG_G,                                 // r
+    SEG_A | SEG_C | SEG_D | SEG_F | SEG_G,         // s
+    SEG_D | SEG_E | SEG_F | SEG_G,                 // t
+    SEG_B | SEG_C | SEG_D | SEG_E | SEG_F,         // u
+    SEG_B | SEG_C | SEG_D | SEG_E | SEG_F,         // v
+    SEG_A | SEG_C | SEG_D | SEG_E,                 // w
+    SEG_B | SEG_C | SEG_E | SEG_F | SEG_G,         // x
+    SEG_B | SEG_C | SEG_D | SEG_F | SEG_G,         // y
+    SEG_A | SEG_B | SEG_D | SEG_E | SEG_G,         // z
+    SEG_B | SEG_C | SEG_G,                         // {
+    SEG_E | SEG_F,                                 // |
+    SEG_E | SEG_F | SEG_G,                         // }
+    SEG_A,                                         // ~
+    DISPLAY_WILDCARD,                              // delete
 };
 
 
@@ -187,17 +357,27 @@ const uint8_t vfd_segment_pins[] PROGMEM = {
     19, // segment A
 };
 
+// animation keyframes pack a nine-bit value with the time until the
+// next keyframe (seven bits, in units of 64 semiticks); tracks
+// of keyframes repeat from the start after DISPLAY_KEYFRAME_END
+#define DISPLAY_KEYFRAME(delay, value) (((delay) << 9) | (value))
+#define DISPLAY_KEYFRAME_END DISPLAY_KEYFRAME(0, 0)
+
+// the following macros extract the fields of a keyframe
+#define DISPLAY_KEYFRAME_DELAY(frame) (((frame) & 0xFE00) >> 3)
+#define DISPLAY_KEYFRAME_VALUE(frame) ((frame) & 0x01FF)
+
 // the following macro encodes the various colon frames
 // delay is time to display the segment (in ~70 ms units)
 // prevdec is true if the decimal of the previous digit should be lit
 // segs is the colon character to display
-#define COLON_FRAME(delay, prevdec, segs) ((delay << 9) | (prevdec ? 0x0100 : 0x0000) | segs)
+#define COLON_FRAME(delay, prevdec, segs) \
+    DISPLAY_KEYFRAME(delay, (prevdec ? 0x0100 : 0x0000) | segs)
 
 // COLON_END is the terminator for a set of colon frames
-#define COLON_FRAME_END COLON_FRAME(0, 0, 0)
+#define COLON_FRAME_END DISPLAY_KEYFRAME_END
 
 // the following macros extract the various fields of a colon frame
-#define COLON_DELAY(frame) ((frame & 0xFE00) >> 3)
 #define COLON_PREVDEC(frame) (frame & 0x0100)
 #define COLON_SEGS(frame) (frame & 0x00FF)
 
@@ -273,8 +453,8 @@ const uint16_t colon_blink[] PROGMEM = {
     COLON_FRAME_END,
 };
 
-// program pointers to rolling colon styles
-#define COLON_SEQUENCES_SIZE 10
+// program pointers to rolling colon styles; a new style
+// needs only its frames and an entry here
 const PROGMEM uint16_t* const colon_styles[] PROGMEM = {
     colon_space,
     colon_decimal_solid,
@@ -288,6 +468,28 @@ const PROGMEM uint16_t* const colon_styles[] PROGMEM = {
     colon_blink,
 };
 
+#define COLON_SEQUENCES_SIZE (sizeof(colon_styles) / sizeof(colon_styles[0]))
+
+
+// keyframes for dot separators; values are DISPLAY_HIDEDOTS or zero
+// (steady dots are stepped only to notice a change of dot style)
+const uint16_t dots_steady[] PROGMEM = {
+    DISPLAY_KEYFRAME(12, 0),
+    DISPLAY_KEYFRAME_END,
+};
+
+const uint16_t dots_flash_slow[] PROGMEM = {
+    DISPLAY_KEYFRAME(12, 0),
+    DISPLAY_KEYFRAME(12, DISPLAY_HIDEDOTS),
+    DISPLAY_KEYFRAME_END,
+};
+
+const uint16_t dots_flash_fast[] PROGMEM = {
+    DISPLAY_KEYFRAME(6, 0),
+    DISPLAY_KEYFRAME(6, DISPLAY_HIDEDOTS),
+    DISPLAY_KEYFRAME_END,
+};
+
 
 #ifdef VFD_TO_SPEC
 #ifndef OCR0B_PWM_DISABLE
@@ -352,11 +554,11 @@ void display_init(void) {
     // disable digital circuitry on photoresistor pins
     DIDR0 |= _BV(ADC5D) | _BV(ADC4D);
 
-    display.multiplex_div = 1;  // multiplexing divider
+    DISPLAY_MULTIPLEX_DIV = 1;  // multiplexing divider
 
 #ifdef VFD_TO_SPEC
-    display.filament_div   = 1;  // ac-frquency divider
-    display.filament_timer = 1;  // ac-generation timer
+    display.filament_div  = 1;  // ac-frquency divider
+    display.filament_step = 0;  // first waveform step
 #endif  // VFD_TO_SPEC
 
 #ifdef AUTOMATIC_DIMMER
@@ -390,6 +592,7 @@ void display_init(void) {
 #endif  // VFD_TO_SPEC
 
     display_loadcolonstyle();
+    display_animstart(DISPLAY_ANIM_DOTS, 1);
 }
 
 
@@ -397,10 +600,17 @@ void display_init(void) {
 uint8_t display_onbutton(void) {
     uint8_t status_old;
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	status_old = display.status;
+	status_old = HOTFLAGS;
 	display_on();
-	display.off_timer = DISPLAY_OFF_TIMEOUT;
+	timer_start(TIMER_DISPLAY_OFF, DISPLAY_OFF_TIMEOUT, 0,
+		    DISPLAY_OFF_CALLBACK);
     }
+
+#ifdef ADAPTIVE_MULTIPLEX_RATE
+    // restore normal multiplexing rate
+    if(display.dim) display_noflicker();
+#endif  // ADAPTIVE_MULTIPLEX_RATE
+
     return status_old & DISPLAY_DISABLED;
 }
 
@@ -418,11 +628,24 @@ void display_wake(void) {
     //   MUX3:0 = 0100:  ADC4 as input
     ADMUX = _BV(MUX2);
 
+#ifdef AUTOMATIC_DIMMER
+    // configure analog to digital converter; conversions are
+    // started by display_varsemitick() and read by ADC_vect
+    // ADEN    =   1:  enable analog to digital converter
+    // ADIE    =   1:  enable conversion complete interrupt
+    // ADPS2:0 = 110:  system clock / 64  (8 MHz / 4 = 125 kHz)
+    ADCSRA = DISPLAY_ADCSRA;
+
+    // gather first photoresistor sample
+    display.photo_sum  = 0;
+    display.photo_conv = DISPLAY_ADC_SAMPLES;
+#else
     // configure analog to digital converter
     // ADEN    =   1:  enable analog to digital converter
     // ADSC    =   1:  start ADC conversion now
     // ADPS2:0 = 110:  system clock / 64  (8 MHz / 4 = 125 kHz)
     ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADPS2) | _BV(ADPS1);
+#endif  // AUTOMATIC_DIMMER
 
     // configure spi sck and mosi pins as outputs
     DDRB |= _BV(PB5) | _BV(PB3);
@@ -462,7 +685,17 @@ void display_wake(void) {
     PORTD &= ~_BV(PD3);
 #endif  // !XMAS_DESIGN
 
-    display.off_timer = DISPLAY_OFF_TIMEOUT;
+#ifdef VFD_TO_SPEC
+    // power VFD cathode (heater fillament) unless display disabled;
+    // a steady (dc) waveform is never rewritten by the overflow handler
+    if(!HOTFLAG_TEST(DISPLAY_DISABLED)) {
+	PORTC = (PORTC & ~FILAMENT_MASK)
+	      | pgm_read_byte(&(display_filament[display.filament_step]));
+    }
+#endif  // VFD_TO_SPEC
+
+    timer_start(TIMER_DISPLAY_OFF, DISPLAY_OFF_TIMEOUT, 0,
+		DISPLAY_OFF_CALLBACK);
     display_on();
 }
 
@@ -507,14 +740,11 @@ void display_sleep(void) {
 }
 
 
-// decrements display-off timer
+// disables display if off conditions met and display-off timer expired
 void display_tick(void) {
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	if(display.off_timer) {
-	    --display.off_timer;
-	    return;
-	}
-    }
+    // when display is disabled, any button press enables the display
+    // for DISPLAY_OFF_TIMEOUT seconds
+    if(timer_active(TIMER_DISPLAY_OFF)) return;
 
 #ifdef AUTOMATIC_DIMMER
     // disable display if dark
@@ -580,14 +810,22 @@ void display_tick(void) {
 // disable display
 void display_off(void) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	if(!(system.status & SYSTEM_SLEEP)
-		&& !(display.status & DISPLAY_DISABLED)) {
-	    display.status |=  DISPLAY_DISABLED;
+	if(!HOTFLAG_TEST(SYSTEM_SLEEP)
+		&& !HOTFLAG_TEST(DISPLAY_DISABLED)) {
+	    // display_semisemitick() stops multiplexing once set
+	    HOTFLAG_SET(DISPLAY_DISABLED);
 	    TCCR0A = _BV(WGM00) | _BV(WGM01);
 	    PORTD &= ~_BV(PD6);  // boost fet off (pull low)
-#ifndef XMAS_DESIGN
+#ifdef XMAS_DESIGN
+	    // park MAX6921:  outputs held low while blank pin is high
+#ifdef VFD_TO_SPEC
+	    PORTD |= _BV(PD5);  // push MAX6921 BLANK pin high
+#else
+	    PORTC |= _BV(PC3);  // push MAX6921 BLANK pin high
+#endif  // VFD_TO_SPEC
+#else
 	    PORTD |=  _BV(PD3);  // MAX6921 power off (pull high)
-#endif  // !XMAS_DESIGN
+#endif  // XMAS_DESIGN
 #ifdef VFD_TO_SPEC
 	    // disable VFD cathode (heater fillament)
 	    PORTC &= ~_BV(PC2) & ~_BV(PC3);  // pull to ground
@@ -600,9 +838,9 @@ void display_off(void) {
 // enable display
 void display_on(void) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	if(!(system.status & SYSTEM_SLEEP)
-		&& (display.status & DISPLAY_DISABLED)) {
-	    display.status &= ~DISPLAY_DISABLED;
+	if(!HOTFLAG_TEST(SYSTEM_SLEEP)
+		&& HOTFLAG_TEST(DISPLAY_DISABLED)) {
+	    HOTFLAG_CLEAR(DISPLAY_DISABLED);
 #ifdef VFD_TO_SPEC
 	    // enable boost and blank pwm
 #ifdef OCR0B_PWM_DISABLE
@@ -612,18 +850,51 @@ void display_on(void) {
 		     | _BV(WGM00)  | _BV(WGM01);
 #endif  // OCR0B_PWM_DISABLE
 
-	    // power VFD cathode (heater fillament)
-	    PORTC |=  _BV(PC2);
-	    PORTC &= ~_BV(PC3);
+	    // power VFD cathode (heater fillament) at current step
+	    PORTC = (PORTC & ~FILAMENT_MASK)
+		  | pgm_read_byte(&(display_filament[display.filament_step]));
 #else
 	    TCCR0A = _BV(COM0A1) | _BV(WGM00) | _BV(WGM01);
 #endif  // VFD_TO_SPEC
 #ifndef XMAS_DESIGN
 	    PORTD &= ~_BV(PD3);  // MAX6921 power on (pull low)
 #endif  // !XMAS_DESIGN
+
+	    // resume multiplexing on next overflow; the first digit
+	    // unblanks the MAX6921
+	    DISPLAY_MULTIPLEX_DIV = 1;
+	}
+    }
+}
+
+
+#ifdef AUTOMATIC_DIMMER
+// utility function for display_varsemitick();
+// starts a photoresistor conversion if the current sample needs
+// one and the last conversion has been read; called right after
+// the MAX6921 latches a digit, so the sample-and-hold (1.5 adc
+// clocks) falls in the quiet time before the next digit
+static inline void display_startadc(void) {
+    if(display.photo_conv && !(ADCSRA & (_BV(ADSC) | _BV(ADIF)))) {
+	ADCSRA = DISPLAY_ADCSRA | _BV(ADSC);
+    }
+}
+
+
+// adc conversion complete interrupt
+// adds photoresistor conversion to current sample
+ISR(ADC_vect) {
+    if(display.photo_conv) {
+	display.photo_sum += ADC;
+
+	// no multiplexing while display disabled, so convert back
+	// to back (conversion complete clears ADIF)
+	if(--display.photo_conv && HOTFLAG_TEST(DISPLAY_DISABLED)) {
+	    ADCSRA = DISPLAY_ADCSRA | _BV(ADSC);
 	}
     }
 }
+#endif  // AUTOMATIC_DIMMER
 
 
 #ifndef SEGMENT_MULTIPLEXING
@@ -712,26 +983,30 @@ uint8_t display_varsemitick(void) {
     // bits to send MAX6921 (vfd driver chip)
     uint8_t bits[3] = {0, 0, 0};
 
+    // frames only flip outside interrupts, so cache pointers to them
+    const uint8_t* postbuf = display_postbuf()->segs;
+    const uint8_t* prebuf  = display_prebuf()->segs;
+
     // calculate digit contents given transition state
-    uint8_t digit = display.postbuf[digit_idx];
+    uint8_t digit = postbuf[digit_idx];
 
     switch(display.trans_type) {
 	case DISPLAY_TRANS_UP:
 	    switch(display.trans_timer) {
 		case 4:
-		    digit = display_shiftU1(display.postbuf[digit_idx]);
+		    digit = display_shiftU1(postbuf[digit_idx]);
 		    break;
 
 		case 3:
-		    digit = display_shiftU2(display.postbuf[digit_idx]);
+		    digit = display_shiftU2(postbuf[digit_idx]);
 		    break;
 
 		case 2:
-		    digit = display_shiftD2(display.prebuf[digit_idx]);
+		    digit = display_shiftD2(prebuf[digit_idx]);
 		    break;
 
 		case 1:
-		    digit = display_shiftD1(display.prebuf[digit_idx]);
+		    digit = display_shiftD1(prebuf[digit_idx]);
 		    break;
 
 		default:
@@ -742,19 +1017,19 @@ uint8_t display_varsemitick(void) {
 	case DISPLAY_TRANS_DOWN:
 	    switch(display.trans_timer) {
 		case 4:
-		    digit = display_shiftD1(display.postbuf[digit_idx]);
+		    digit = display_shiftD1(postbuf[digit_idx]);
 		    break;
 
 		case 3:
-		    digit = display_shiftD2(display.postbuf[digit_idx]);
+		    digit = display_shiftD2(postbuf[digit_idx]);
 		    break;
 
 		case 2:
-		    digit = display_shiftU2(display.prebuf[digit_idx]);
+		    digit = display_shiftU2(prebuf[digit_idx]);
 		    break;
 
 		case 1:
-		    digit = display_shiftU1(display.prebuf[digit_idx]);
+		    digit = display_shiftU1(prebuf[digit_idx]);
 		    break;
 
 		default:
@@ -776,13 +1051,13 @@ uint8_t display_varsemitick(void) {
 		}
 
 		uint8_t digit_b = (trans_idx < DISPLAY_SIZE
-			           ? display.postbuf[trans_idx]
-			           : display.prebuf[trans_idx - DISPLAY_SIZE]);
+			           ? postbuf[trans_idx]
+			           : prebuf[trans_idx - DISPLAY_SIZE]);
 
 		if(display.trans_timer & 0x01) {
 		    uint8_t digit_a = (--trans_idx < DISPLAY_SIZE
-			               ? display.postbuf[trans_idx]
-			               : display.prebuf[trans_idx
+			               ? postbuf[trans_idx]
+			               : prebuf[trans_idx
 				       			- DISPLAY_SIZE]);
 
 		    digit = display_combineLR(digit_a, digit_b);
@@ -803,7 +1078,7 @@ uint8_t display_varsemitick(void) {
 
 
     // create the sequence of bits for the calculated digit
-    if(!(display.status & DISPLAY_DISABLED)) {
+    if(!HOTFLAG_TEST(DISPLAY_DISABLED)) {
 	// select the digit position to display
 	uint8_t bitidx = pgm_read_byte(&(vfd_digit_pins[digit_idx]));
 	bits[bitidx >> 3] |= _BV(bitidx & 0x7);
@@ -885,7 +1160,12 @@ uint8_t display_varsemitick(void) {
     PORTC |=  _BV(PC0);
     PORTC &= ~_BV(PC0);
 
-    if(!(display.status & DISPLAY_DISABLED)) {
+#ifdef AUTOMATIC_DIMMER
+    // sample photoresistor while the display is quiet
+    display_startadc();
+#endif  // AUTOMATIC_DIMMER
+
+    if(!HOTFLAG_TEST(DISPLAY_DISABLED)) {
 	// unblank display to prevent ghosting
 #ifdef VFD_TO_SPEC
 	// enable pwm on blank pin
@@ -911,7 +1191,7 @@ uint8_t display_varsemitick(void) {
 #ifdef SEGMENT_MULTIPLEXING
 // utility function for display_varsemitick();
 // shifts digits up by one
-static inline void display_shiftU1(uint8_t bits[], volatile uint8_t buf[],
+static inline void display_shiftU1(uint8_t bits[], const uint8_t buf[],
 	                    uint8_t segment) {
     switch(segment) {
       case SEG_A:
@@ -942,7 +1222,7 @@ static inline void display_shiftU1(uint8_t bits[], volatile uint8_t buf[],
 
 // utility function for display_varsemitick();
 // shifts digits up by two
-static inline void display_shiftU2(uint8_t bits[], volatile uint8_t buf[],
+static inline void display_shiftU2(uint8_t bits[], const uint8_t buf[],
 	                    uint8_t segment) {
     if(segment == SEG_A) {
 	for(uint8_t digit_idx = 1; digit_idx < DISPLAY_SIZE; ++digit_idx) {
@@ -957,7 +1237,7 @@ static inline void display_shiftU2(uint8_t bits[], volatile uint8_t buf[],
 
 // utility function for display_varsemitick();
 // shifts digits down by one
-static inline void display_shiftD1(uint8_t bits[], volatile uint8_t buf[],
+static inline void display_shiftD1(uint8_t bits[], const uint8_t buf[],
 	                    uint8_t segment) {
     switch(segment) {
       case SEG_G:
@@ -987,7 +1267,7 @@ static inline void display_shiftD1(uint8_t bits[], volatile uint8_t buf[],
 
 // utility function for display_varsemitick();
 // shifts digits down by two
-static inline void display_shiftD2(uint8_t bits[], volatile uint8_t buf[],
+static inline void display_shiftD2(uint8_t bits[], const uint8_t buf[],
 	                    uint8_t segment) {
     if(segment == SEG_D) {
 	for(uint8_t digit_idx = 1; digit_idx < DISPLAY_SIZE; ++digit_idx) {
@@ -1006,6 +1286,9 @@ static inline void display_shiftL(uint8_t bits[], uint8_t segment) {
     uint8_t digit_idx = 0;
     uint8_t trans_idx = DISPLAY_SIZE - (display.trans_timer >> 1);
 
+    const uint8_t* postbuf = display_postbuf()->segs;
+    const uint8_t* prebuf  = display_prebuf()->segs;
+
     if(display.trans_timer & 0x01) {
 	switch(segment) {
 	    case SEG_B:
@@ -1034,10 +1317,10 @@ static inline void display_shiftL(uint8_t bits[], uint8_t segment) {
 
 	if(trans_idx < DISPLAY_SIZE) {
 	    if(trans_idx == 0) continue;
-	    digit = display.postbuf[trans_idx];
+	    digit = postbuf[trans_idx];
 	} else {
 	    if(trans_idx == DISPLAY_SIZE) continue;
-	    digit = display.prebuf[trans_idx - DISPLAY_SIZE];
+	    digit = prebuf[trans_idx - DISPLAY_SIZE];
 	}
 
 	if(digit & segment) {
@@ -1050,7 +1333,7 @@ static inline void display_shiftL(uint8_t bits[], uint8_t segment) {
 
 // utility function for display_varsemitick();
 // sets bit for given segment
-void display_noshift(uint8_t bits[], volatile uint8_t buf[],
+void display_noshift(uint8_t bits[], const uint8_t buf[],
 		     uint8_t segment) {
     for(uint8_t digit_idx = 0; digit_idx < DISPLAY_SIZE; ++digit_idx) {
 	if(buf[digit_idx] & segment) {
@@ -1077,31 +1360,35 @@ uint8_t display_varsemitick(void) {
     uint8_t bitidx = pgm_read_byte(&(vfd_segment_pins[segment_idx]));
     bits[bitidx >> 3] |= _BV(bitidx & 0x7);
 
+    // frames only flip outside interrupts, so cache pointers to them
+    const uint8_t* postbuf = display_postbuf()->segs;
+    const uint8_t* prebuf  = display_prebuf()->segs;
+
     switch(display.trans_type) {
 	case DISPLAY_TRANS_UP:
 	    switch(display.trans_timer) {
 		case 5:
-		    display_noshift(bits, display.postbuf, segment);
+		    display_noshift(bits, postbuf, segment);
 		    break;
 
 		case 4:
-		    display_shiftU1(bits, display.postbuf, segment);
+		    display_shiftU1(bits, postbuf, segment);
 		    break;
 
 		case 3:
-		    display_shiftU2(bits, display.postbuf, segment);
+		    display_shiftU2(bits, postbuf, segment);
 		    break;
 
 		case 2:
-		    display_shiftD2(bits, display.prebuf, segment);
+		    display_shiftD2(bits, prebuf, segment);
 		    break;
 
 		case 1:
-		    display_shiftD1(bits, display.prebuf, segment);
+		    display_shiftD1(bits, prebuf, segment);
 		    break;
 
 		default:
-		    display_noshift(bits, display.prebuf, segment);
+		    display_noshift(bits, prebuf, segment);
 		    break;
 	    }
 	    break;
@@ -1109,49 +1396,49 @@ uint8_t display_varsemitick(void) {
 	case DISPLAY_TRANS_DOWN:
 	    switch(display.trans_timer) {
 		case 5:
-		    display_noshift(bits, display.postbuf, segment);
+		    display_noshift(bits, postbuf, segment);
 		    break;
 
 		case 4:
-		    display_shiftD1(bits, display.postbuf, segment);
+		    display_shiftD1(bits, postbuf, segment);
 		    break;
 
 		case 3:
-		    display_shiftD2(bits, display.postbuf, segment);
+		    display_shiftD2(bits, postbuf, segment);
 		    break;
 
 		case 2:
-		    display_shiftU2(bits, display.prebuf, segment);
+		    display_shiftU2(bits, prebuf, segment);
 		    break;
 
 		case 1:
-		    display_shiftU1(bits, display.prebuf, segment);
+		    display_shiftU1(bits, prebuf, segment);
 		    break;
 
 		default:
-		    display_noshift(bits, display.prebuf, segment);
+		    display_noshift(bits, prebuf, segment);
 		    break;
 	    }
 	    break;
 
 	case DISPLAY_TRANS_LEFT:
 	    if(display.trans_timer >= 2 * DISPLAY_SIZE) {
-		display_noshift(bits, display.postbuf, segment);
+		display_noshift(bits, postbuf, segment);
 	    } else if(display.trans_timer) {
 		display_shiftL(bits, segment);
 	    } else if(display.trans_timer < 2 * DISPLAY_SIZE) {
-		display_noshift(bits, display.prebuf, segment);
+		display_noshift(bits, prebuf, segment);
 	    }
 	    break;
 
 	default:
-	    display_noshift(bits, display.postbuf, segment);
+	    display_noshift(bits, postbuf, segment);
 	    break;
     }
 
 
     // create the sequence of bits for the calculated digit
-    if(!(display.status & DISPLAY_DISABLED)) {
+    if(!HOTFLAG_TEST(DISPLAY_DISABLED)) {
 	// blank display to prevent ghosting
 #ifdef VFD_TO_SPEC
 	// disable pwm on blank pin
@@ -1202,7 +1489,12 @@ uint8_t display_varsemitick(void) {
     PORTC |=  _BV(PC0);
     PORTC &= ~_BV(PC0);
 
-    if(!(display.status & DISPLAY_DISABLED)) {
+#ifdef AUTOMATIC_DIMMER
+    // sample photoresistor while the display is quiet
+    display_startadc();
+#endif  // AUTOMATIC_DIMMER
+
+    if(!HOTFLAG_TEST(DISPLAY_DISABLED)) {
 	// unblank display to prevent ghosting
 #ifdef VFD_TO_SPEC
 #ifdef OCR0B_PWM_DISABLE
@@ -1225,6 +1517,185 @@ uint8_t display_varsemitick(void) {
 #endif  // SEGMENT_MULTIPLEXING
 
 
+// start the frame being drawn from the contents of the frame just
+// flipped to the front, so drawing can update the display piecemeal;
+// the multiplexing interrupt reads only the front frame, so the copy
+// needs no atomic block
+static inline void display_syncprebuf(void) {
+    *display_prebuf() = *display_postbuf();
+}
+
+
+#ifdef DISPLAY_MARQUEE
+// begin scrolling marquee text from a blank display
+static void display_marquee_start(const char* text, uint8_t flags) {
+    display_clearall();
+    display_transition(DISPLAY_TRANS_INSTANT);
+
+    display.marquee_flags = flags;
+    display.marquee_tail  = DISPLAY_SIZE - 1;
+    display.marquee_timer = 1;  // first character on next semitick
+    display.marquee_text  = text;
+}
+
+
+// shift marquee text one position left and feed the next character
+// into the rightmost position; only the new character is rendered,
+// so each step takes the same time whatever the length of the text
+static void display_marquee_step(void) {
+    char c;
+
+    if(display.marquee_flags & DISPLAY_MARQUEE_PSTR) {
+	c = pgm_read_byte(display.marquee_text);
+    } else {
+	c = *display.marquee_text;
+    }
+
+    if(c) {
+	++display.marquee_text;
+    } else if(display.marquee_tail) {
+	// blank positions scroll the end of the text off the display
+	--display.marquee_tail;
+	c = ' ';
+    } else {
+	display.marquee_text = 0;
+	return;
+    }
+
+    // position zero (dash and circle) is not part of the marquee
+    display_frame_t* prebuf = display_prebuf();
+
+    for(uint8_t i = 1; i < DISPLAY_SIZE - 1; ++i) {
+	prebuf->segs[i] = prebuf->segs[i + 1];
+    }
+    prebuf->colons <<= 1;
+
+    display_char(DISPLAY_SIZE - 1, c);
+    display_transition(DISPLAY_TRANS_INSTANT);
+}
+#endif  // DISPLAY_MARQUEE
+
+
+// schedule the next step of an animation track in delay semiticks
+// (at least one), starting the track if stopped
+static void display_animstart(uint8_t track, uint16_t delay) {
+    uint16_t elapsed = display.anim_span - display.anim_wait;
+
+    display.anim_delay[track] = elapsed + delay;
+    display.anim_active |= _BV(track);
+
+    // wake sooner if this track is due first
+    if(!display.anim_wait || delay < display.anim_wait) {
+	display.anim_span = elapsed + delay;
+	display.anim_wait = delay;
+    }
+}
+
+
+// stop an animation track; the engine may still wake when
+// the track would have been due, but will not step it
+static inline void display_animstop(uint8_t track) {
+    display.anim_active &= ~_BV(track);
+}
+
+
+// returns keyframe (*idx) of the given track, starting over
+// at the end of the track, and advances (*idx)
+static uint16_t display_keyframe(const uint16_t* track,
+				 volatile uint8_t* idx) {
+    uint16_t frame = pgm_read_word( &(track[*idx]) );
+
+    if(frame == DISPLAY_KEYFRAME_END) {
+	*idx = 0;
+	frame = pgm_read_word( &(track[0]) );
+    }
+
+    ++*idx;
+    return frame;
+}
+
+
+// show next blinking dot keyframe for the current dot style;
+// returns semiticks until the following keyframe
+static uint16_t display_stepdots(void) {
+    const uint16_t* track = dots_steady;
+
+    if(time.timeformat_flags & TIME_TIMEFORMAT_DOTFLASH_SLOW) {
+	track = dots_flash_slow;
+    } else if(time.timeformat_flags & TIME_TIMEFORMAT_DOTFLASH_FAST) {
+	track = dots_flash_fast;
+    }
+
+    uint16_t frame = display_keyframe(track, &display.dot_frame_idx);
+
+    if((display.status ^ DISPLAY_KEYFRAME_VALUE(frame)) & DISPLAY_HIDEDOTS) {
+	display.status ^= DISPLAY_HIDEDOTS;
+	display_updatedots();
+    }
+
+    return DISPLAY_KEYFRAME_DELAY(frame);
+}
+
+
+// step pulsing brightness one level up or down;
+// returns semiticks until the next step
+static uint16_t display_steppulse(void) {
+    static uint8_t grad_idx = 0;
+
+    if(HOTFLAG_TEST(DISPLAY_PULSE_DOWN)) {
+	if(grad_idx == 0x00) {
+	    HOTFLAG_CLEAR(DISPLAY_PULSE_DOWN);
+	} else {
+	    display_setbrightness(--grad_idx);
+	}
+    } else {
+	if(grad_idx == 80) {
+	    HOTFLAG_SET(DISPLAY_PULSE_DOWN);
+	} else {
+	    display_setbrightness(++grad_idx);
+	}
+    }
+
+    return DISPLAY_PULSE_DELAY;
+}
+
+
+// step each animation track whose keyframe is due and schedule
+// the next wake; called when display.anim_wait reaches zero
+static void display_animwake(void) {
+    uint16_t next = 0;
+
+    for(uint8_t track = 0; track < DISPLAY_ANIM_COUNT; ++track) {
+	if(!(display.anim_active & _BV(track))) continue;
+
+	uint16_t delay = display.anim_delay[track] - display.anim_span;
+
+	if(!delay) {
+	    if(track == DISPLAY_ANIM_PULSE) {
+		delay = display_steppulse();
+	    } else if(display.trans_type != DISPLAY_TRANS_NONE) {
+		// colons and dots hold still during transitions
+		delay = 1;
+	    } else if(track == DISPLAY_ANIM_COLONS) {
+		display_nextcolonframe();
+		delay = DISPLAY_KEYFRAME_DELAY(display.colon_frame);
+	    } else {
+		delay = display_stepdots();
+	    }
+
+	    // every keyframe lasts at least one semitick
+	    if(!delay) delay = 1;
+	}
+
+	display.anim_delay[track] = delay;
+	if(!next || delay < next) next = delay;
+    }
+
+    display.anim_span = next;
+    display.anim_wait = next;
+}
+
+
 // called every semisecond; updates ambient brightness running average
 void display_semitick(void) {
     // Update the display transition variables as time passes:
@@ -1232,6 +1703,7 @@ void display_semitick(void) {
     // to display on-the-fly from the transition variables.
 
     static uint16_t trans_delay_timer = 0;
+    uint8_t flipped = FALSE;
 
     // calculate timer values for scrolling display
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
@@ -1254,19 +1726,54 @@ void display_semitick(void) {
 			    break;
 		    }
 		} else {
-		    for(uint8_t i = 0; i < DISPLAY_SIZE; ++i) {
-			display.postbuf[i] = display.prebuf[i];
-		    }
-
-		    display.dot_postbuf   = display.dot_prebuf;
-		    display.colon_postbuf = display.colon_prebuf;
-
+		    // show the new frame by flipping frames
+		    display.front ^= 1;
 		    display.trans_type = DISPLAY_TRANS_NONE;
+		    flipped = TRUE;
 		}
 	    }
 	}
     }
 
+    if(flipped) display_syncprebuf();
+
+
+#ifdef DISPLAY_MARQUEE
+    // scroll marquee text one character per step
+    if(display.marquee_text && !--display.marquee_timer) {
+	display.marquee_timer = DISPLAY_MARQUEE_DELAY;
+	display_marquee_step();
+    }
+#endif  // DISPLAY_MARQUEE
+
+
+#ifdef BOOST_LOAD_TRIM
+    // count lit segments and trim boost when the count changes;
+    // recount when frames flip, and every 16 semiseconds for
+    // instant transitions and direct writes to the displayed frame
+    static uint8_t trim_timer = DISPLAY_ADC_DELAY;
+
+    if(flipped || !--trim_timer) {
+	trim_timer = DISPLAY_ADC_DELAY;
+
+	uint8_t lit_segments = 0;
+
+	for(uint8_t i = 0; i < DISPLAY_SIZE; ++i) {
+	    uint8_t segs = display_postbuf()->segs[i];
+
+	    while(segs) {
+		segs &= segs - 1;  // clear lowest lit segment
+		++lit_segments;
+	    }
+	}
+
+	if(lit_segments != display.lit_segments) {
+	    display.lit_segments = lit_segments;
+	    display_trimboost();
+	}
+    }
+#endif  // BOOST_LOAD_TRIM
+
 
 #ifdef AUTOMATIC_DIMMER
     // get ambient lighting from photosensor every 16 semiseconds,
@@ -1278,71 +1785,50 @@ void display_semitick(void) {
 	// repeat in 16 semiseconds
         photo_timer = DISPLAY_ADC_DELAY;
 
-	// update adc running average (display.photo_avg)
-	display.photo_avg -= (display.photo_avg >> 6);
-	display.photo_avg += ADC;
-
-        // begin next analog to digital conversion
-        ADCSRA |= _BV(ADSC);
-
-	// update brightness from display.photo_avg if not pulsing
-	if(!(display.status & DISPLAY_PULSING)) display_autodim();
-    }
-#endif  // AUTOMATIC_DIMMER
-
-
-    // update display brightness if pulsing
-    if(display.status & DISPLAY_PULSING) {
-	static uint8_t pulse_timer = DISPLAY_PULSE_DELAY;
+	uint16_t photo_sum = 0;
+	uint8_t  photo_conv;
 
-	if(! --pulse_timer) {
-	    pulse_timer = DISPLAY_PULSE_DELAY;
+	// take completed sample and begin next
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	    photo_conv = display.photo_conv;
 
-	    static uint8_t grad_idx = 0;
-
-	    if(display.status & DISPLAY_PULSE_DOWN) {
-		if(grad_idx == 0x00) {
-		    display.status &= ~DISPLAY_PULSE_DOWN;
-		} else {
-		    display_setbrightness(--grad_idx);
-		}
-	    } else {
-		if(grad_idx == 80) {
-		    display.status |=  DISPLAY_PULSE_DOWN;
-		} else {
-		    display_setbrightness(++grad_idx);
-		}
+	    if(!photo_conv) {
+		photo_sum = display.photo_sum;
+		display.photo_sum  = 0;
+		display.photo_conv = DISPLAY_ADC_SAMPLES;
 	    }
+
+	    // display_varsemitick() starts no conversions
+	    // while display disabled
+	    if(HOTFLAG_TEST(DISPLAY_DISABLED)) display_startadc();
 	}
-    }
 
-    // handle the animated colons
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	if(display.trans_type == DISPLAY_TRANS_NONE) {
-	    if(++display.colon_timer >= COLON_DELAY(display.colon_frame)) {
-		display.colon_timer = 0;
-		NONATOMIC_BLOCK(NONATOMIC_FORCEOFF) {
-		    display_nextcolonframe();
-		}
-	    }
+	if(!photo_conv) {
+	    // decimate oversampled conversions to the 2^6 scale
+	    // of display.photo_avg, then update running average
+	    photo_sum <<= 6 - DISPLAY_ADC_SAMPLES_LOG2;
+	    display.photo_avg -= display.photo_avg >> DISPLAY_ADC_FILTER;
+	    display.photo_avg += photo_sum >> DISPLAY_ADC_FILTER;
 	}
+
+	// update brightness from display.photo_avg if not pulsing
+	if(!HOTFLAG_TEST(DISPLAY_PULSING)) display_autodim();
     }
+#endif  // AUTOMATIC_DIMMER
 
-    // handle blinking dot separators
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	if(display.trans_type == DISPLAY_TRANS_NONE) {
-	    if(    ((time.timeformat_flags & TIME_TIMEFORMAT_DOTFLASH_SLOW)
-		      && ++display.dot_timer >= DISPLAY_DOTFLASH_SLOW_TIME)
-		|| ((time.timeformat_flags & TIME_TIMEFORMAT_DOTFLASH_FAST)
-		      && ++display.dot_timer >= DISPLAY_DOTFLASH_FAST_TIME)) {
-		display.status ^= DISPLAY_HIDEDOTS;
-		display.dot_timer = 0;
-		NONATOMIC_BLOCK(NONATOMIC_FORCEOFF) {
-		    display_updatedots();
-		}
-	    }
+
+    // pulse brightness while the hot flag is set
+    if(HOTFLAG_TEST(DISPLAY_PULSING)) {
+	if(!(display.anim_active & _BV(DISPLAY_ANIM_PULSE))) {
+	    display_animstart(DISPLAY_ANIM_PULSE, DISPLAY_PULSE_DELAY);
 	}
+    } else if(display.anim_active & _BV(DISPLAY_ANIM_PULSE)) {
+	display_animstop(DISPLAY_ANIM_PULSE);
     }
+
+    // step animated colons, blinking dots, and pulsing
+    // only when the next keyframe is due
+    if(display.anim_wait && !--display.anim_wait) display_animwake();
 }
 
 
@@ -1374,10 +1860,11 @@ void display_loadcolonstyle(void) {
 	    display.colon_style_idx = 0;
 	}
 	display.colon_frame_idx = 0;
-	display.colon_timer = 0;
     }
 
-    display_updatecolons();
+    display_loadcolonframe();
+    display_animstart(DISPLAY_ANIM_COLONS,
+		      DISPLAY_KEYFRAME_DELAY(display.colon_frame));
 }
 
 
@@ -1389,10 +1876,12 @@ void display_nextcolonstyle(void) {
 	}
 
 	display.colon_frame_idx = 0;
-	display.colon_timer     = 0;
 
 	display_loadcolonframe();
     }
+
+    display_animstart(DISPLAY_ANIM_COLONS,
+		      DISPLAY_KEYFRAME_DELAY(display.colon_frame));
 }
 
 
@@ -1431,22 +1920,25 @@ void display_nextcolonframe(void) {
 
 // updates display for colon separators
 void display_updatecolons(void) {
+    display_frame_t* prebuf  = display_prebuf();
+    display_frame_t* postbuf = display_postbuf();
+
     for(uint8_t bit=1, idx=8; bit; bit <<= 1, --idx) {
-	if(bit & display.colon_prebuf) {
-	    display.prebuf[idx] = COLON_SEGS(display.colon_frame);
+	if(bit & prebuf->colons) {
+	    prebuf->segs[idx] = COLON_SEGS(display.colon_frame);
 	    if(COLON_PREVDEC(display.colon_frame)) {
-		display.prebuf[idx-1] |= SEG_H;
+		prebuf->segs[idx-1] |= SEG_H;
 	    } else {
-		display.prebuf[idx-1] &= ~SEG_H;
+		prebuf->segs[idx-1] &= ~SEG_H;
 	    }
 	}
 
-	if(bit & display.colon_postbuf) {
-	    display.postbuf[idx] = COLON_SEGS(display.colon_frame);
+	if(bit & postbuf->colons) {
+	    postbuf->segs[idx] = COLON_SEGS(display.colon_frame);
 	    if(COLON_PREVDEC(display.colon_frame)) {
-		display.postbuf[idx-1] |= SEG_H;
+		postbuf->segs[idx-1] |= SEG_H;
 	    } else {
-		display.postbuf[idx-1] &= ~SEG_H;
+		postbuf->segs[idx-1] &= ~SEG_H;
 	    }
 	}
     }
@@ -1468,28 +1960,33 @@ void display_nextdotstyle(void) {
 	}
 
 	display.status &= ~DISPLAY_HIDEDOTS;
-	display.dot_timer = 0;
+	display.dot_frame_idx = 0;
     }
+
+    display_animstart(DISPLAY_ANIM_DOTS, 1);
 }
 
 
 // updates display for colon separators
 void display_updatedots(void) {
+    display_frame_t* prebuf  = display_prebuf();
+    display_frame_t* postbuf = display_postbuf();
+
     // apply style to colon positions
     for(uint8_t bit=1, idx=7; bit; bit <<= 1, --idx) {
-	if(bit & display.dot_prebuf) {
+	if(bit & prebuf->dots) {
 	    if(display.status & DISPLAY_HIDEDOTS) {
-		display.prebuf[idx] &= ~SEG_H;
+		prebuf->segs[idx] &= ~SEG_H;
 	    } else {
-		display.prebuf[idx] |= SEG_H;
+		prebuf->segs[idx] |= SEG_H;
 	    }
 	}
 
-	if(bit & display.dot_postbuf) {
+	if(bit & postbuf->dots) {
 	    if(display.status & DISPLAY_HIDEDOTS) {
-		display.postbuf[idx] &= ~SEG_H;
+		postbuf->segs[idx] &= ~SEG_H;
 	    } else {
-		display.postbuf[idx] |= SEG_H;
+		postbuf->segs[idx] |= SEG_H;
 	    }
 	}
     }
@@ -1498,18 +1995,38 @@ void display_updatedots(void) {
 
 // clear the given display position
 void display_clear(uint8_t idx) {
-    display.prebuf[idx] = DISPLAY_SPACE;
+    display_prebuf()->segs[idx] = DISPLAY_SPACE;
 }
 
 
 // clears entire display
 void display_clearall(void) {
+    display_frame_t* prebuf = display_prebuf();
+
+    for(uint8_t i = 0; i < DISPLAY_SIZE; ++i) {
+	prebuf->segs[i] = DISPLAY_SPACE;
+    }
+
+    prebuf->dots   = 0;
+    prebuf->colons = 0;
+}
+
+
+// returns true if the frame being drawn differs from the current display
+uint8_t display_changed(void) {
+    display_frame_t* prebuf  = display_prebuf();
+    display_frame_t* postbuf = display_postbuf();
+
+    if(prebuf->dots   != postbuf->dots
+	    || prebuf->colons != postbuf->colons) {
+	return TRUE;
+    }
+
     for(uint8_t i = 0; i < DISPLAY_SIZE; ++i) {
-	display.prebuf[i] = DISPLAY_SPACE;
+	if(prebuf->segs[i] != postbuf->segs[i]) return TRUE;
     }
 
-    display.dot_prebuf   = 0;
-    display.colon_prebuf = 0;
+    return FALSE;
 }
 
 
@@ -1537,6 +2054,29 @@ void display_pstr(const uint8_t idx, PGM_P pstr) {
 }
 
 
+#ifdef DISPLAY_MARQUEE
+// scroll the given program memory string leftward across the display,
+// one character per step, until its last character has scrolled off;
+// the string may be of any length and is read as it scrolls
+void display_marquee_pstr(PGM_P pstr) {
+    display_marquee_start(pstr, DISPLAY_MARQUEE_PSTR);
+}
+
+
+// scroll the given string leftward across the display; the string is
+// read as it scrolls, so it must not change until the marquee finishes
+void display_marquee_str(const char* str) {
+    display_marquee_start(str, 0);
+}
+
+
+// stop scrolling marquee text, leaving the display as it is
+void display_marquee_stop(void) {
+    display.marquee_text = 0;
+}
+#endif  // DISPLAY_MARQUEE
+
+
 // load display brightness from eeprom
 void display_loadbright(void) {
 #ifdef AUTOMATIC_DIMMER
@@ -1582,17 +2122,29 @@ void display_savedigittimes(void) {
 // calculates new digit time shift to prevent flicker
 void display_noflicker(void) {
     uint16_t total_digit_time = 0;
+    uint16_t frame_time = DISPLAY_NOFLICKER_TIME;
 
     for(uint8_t i = 0; i < DISPLAY_SIZE; ++i) {
 	total_digit_time += display.digit_times[i];
     }
 
-    display.digit_time_shift = 0;
+#ifdef ADAPTIVE_MULTIPLEX_RATE
+    // flicker is less visible on a dim display, so multiplex
+    // slowly unless a button was pressed recently
+    if(display.dim && !timer_active(TIMER_DISPLAY_OFF)) {
+	frame_time = ADAPTIVE_MULTIPLEX_TIME;
+    }
+#endif  // ADAPTIVE_MULTIPLEX_RATE
 
-    while( (total_digit_time >> display.digit_time_shift)
-	    > DISPLAY_NOFLICKER_TIME ) {
-	++display.digit_time_shift;
+    // find shift before storing it, as display_varsemitick() may
+    // run at any time
+    uint8_t shift = 0;
+
+    while( (total_digit_time >> shift) > frame_time ) {
+	++shift;
     }
+
+    display.digit_time_shift = shift;
 }
 #endif //  ~SEGMENT_MULTIPLEXING
 
@@ -1674,6 +2226,16 @@ void display_autodim(void) {
     if(grad_idx < 0)  grad_idx = 0;
 
     display_setbrightness(grad_idx);
+
+#ifdef ADAPTIVE_MULTIPLEX_RATE
+    // adjust multiplexing rate when crossing dim threshold
+    uint8_t dim = (grad_idx <= (ADAPTIVE_MULTIPLEX_LEVEL << 3));
+
+    if(dim != display.dim) {
+	display.dim = dim;
+	display_noflicker();
+    }
+#endif  // ADAPTIVE_MULTIPLEX_RATE
 }
 
 
@@ -1700,28 +2262,58 @@ void display_setbrightness(int8_t level) {
     if(new_OCR0A < OCR0A_MIN) new_OCR0A = OCR0A_MIN;
     if(new_OCR0A > OCR0A_MAX) new_OCR0A = OCR0A_MAX;
 
+#ifdef BOOST_LOAD_TRIM
+    // set new brightness, less trim for current load
+    display.boost_base = new_OCR0A;
+    display_trimboost();
+#else
     // set new brightness
     OCR0A = new_OCR0A;
+#endif  // BOOST_LOAD_TRIM
 #endif  // OCR0A_VALUE
 }
 
 
-// display digit (n) on display position (idx)
-void display_digit(uint8_t idx, uint8_t n) {
+#ifdef BOOST_LOAD_TRIM
+// set OCR0A from display.boost_base, trimmed linearly from
+// BOOST_LOAD_TRIM percent with no segments lit to none with all lit
+void display_trimboost(void) {
+    uint8_t span = display.boost_base - OCR0A_MIN;
+
+    uint8_t trim = ((uint32_t)span * BOOST_LOAD_TRIM
+		    * (DISPLAY_SEGMENTS_MAX - display.lit_segments))
+		   / (100UL * DISPLAY_SEGMENTS_MAX);
+
+    OCR0A = display.boost_base - trim;
+}
+#endif  // BOOST_LOAD_TRIM
+
+
+// display decimal digit (d), which must be below
+// ten, on display position (idx)
+static inline void display_decimal(uint8_t idx, uint8_t d) {
+    display_frame_t* prebuf = display_prebuf();
+
     // clear blinking dot, if any
-    display.dot_prebuf &= ~_BV(7 - idx);
+    prebuf->dots &= ~_BV(7 - idx);
 
     // clear colon char, if any
-    display.colon_prebuf &= ~_BV(8 - idx);
+    prebuf->colons &= ~_BV(8 - idx);
 
-    display.prebuf[idx] = pgm_read_byte( &(number_segments[(n % 10)]) );
+    prebuf->segs[idx] = pgm_read_byte( &(number_segments[d]) );
 
-    if(n == 9 && (display.status & DISPLAY_ALTNINE)) {
-	display.prebuf[idx] |= SEG_D;
+    if(d == 9 && (display.status & DISPLAY_ALTNINE)) {
+	prebuf->segs[idx] |= SEG_D;
     }
 }
 
 
+// display digit (n) on display position (idx)
+void display_digit(uint8_t idx, uint8_t n) {
+    display_decimal(idx, n % 10);
+}
+
+
 // display zero-padded two-digit number (n)
 // at display positions (idx & idx+1)
 void display_twodigit_rightadj(uint8_t idx, int8_t n) {
@@ -1775,50 +2367,58 @@ void display_twodigit_zeropad(uint8_t idx, int8_t n) {
 }
 
 
+#ifdef TIME_BCD
+// display right-adjusted packed-bcd number (bcd)
+// at display positions (idx & idx+1)
+void display_twodigit_bcd_rightadj(uint8_t idx, uint8_t bcd) {
+    if(!(display.status & DISPLAY_ZEROPAD) && bcd < 0x10) {
+	display_clear(idx);
+	display_decimal(++idx, bcd);
+    } else {
+	display_twodigit_bcd_zeropad(idx, bcd);
+    }
+}
+
+
+// display zero-padded packed-bcd number (bcd) at display
+// positions (idx & idx+1); nibbles select digits directly
+void display_twodigit_bcd_zeropad(uint8_t idx, uint8_t bcd) {
+    display_decimal(  idx, bcd >> 4);
+    display_decimal(++idx, bcd & 0x0F);
+}
+#endif  // TIME_BCD
+
+
 // display character (c) at display position (idx)
 void display_char(uint8_t idx, char c) {
+    display_frame_t* prebuf = display_prebuf();
+
     // clear blinking dot, if any
-    display.dot_prebuf &= ~_BV(7 - idx);
+    prebuf->dots &= ~_BV(7 - idx);
 
     // process colon
     if(c == ':') {
-	display.colon_prebuf |= _BV(8 - idx);
-	display.prebuf[idx] = COLON_SEGS(display.colon_frame);
-	if(idx && COLON_PREVDEC(display.colon_frame)) display.prebuf[idx-1] |= SEG_H;
+	prebuf->colons |= _BV(8 - idx);
+	prebuf->segs[idx] = COLON_SEGS(display.colon_frame);
+	if(idx && COLON_PREVDEC(display.colon_frame)) prebuf->segs[idx-1] |= SEG_H;
 	return;
     } else {
-	display.colon_prebuf &= ~_BV(8 - idx);
+	prebuf->colons &= ~_BV(8 - idx);
     }
 
-    if('a' <= c && c <= 'z') {
-	if(display.status & DISPLAY_ALTALPHA) {
-	    display.prebuf[idx] = pgm_read_byte(&(letter_segments_alt[c-'a']));
-	} else {
-	    display.prebuf[idx] = pgm_read_byte(&(letter_segments_ada[c-'a']));
-	}
-    } else if('A' <= c && c <= 'Z') {
-	if(display.status & DISPLAY_ALTALPHA) {
-	    display.prebuf[idx] = pgm_read_byte(&(letter_segments_alt[c-'A']));
-	} else {
-	    display.prebuf[idx] = pgm_read_byte(&(letter_segments_ada[c-'A']));
-	}
-    } else if('0' <= c && c <= '9') {
-	display_digit(idx, c - '0');
+    // one table lookup; characters outside the font show as wildcards
+    uint8_t i = c - DISPLAY_FONT_FIRST;
+
+    if(i >= DISPLAY_FONT_SIZE) {
+	prebuf->segs[idx] = DISPLAY_WILDCARD;
+    } else if(display.status & DISPLAY_ALTALPHA) {
+	prebuf->segs[idx] = pgm_read_byte( &(display_font_alt[i]) );
     } else {
-	switch(c) {
-	    case ' ':
-		display.prebuf[idx] = DISPLAY_SPACE;
-		break;
-	    case '-':
-		display.prebuf[idx] = DISPLAY_DASH;
-		break;
-	    case '/':
-		display.prebuf[idx] = DISPLAY_SLASH;
-		break;
-	    default:
-		display.prebuf[idx] = DISPLAY_WILDCARD;
-		break;
-	}
+	prebuf->segs[idx] = pgm_read_byte( &(display_font_ada[i]) );
+    }
+
+    if(c == '9' && (display.status & DISPLAY_ALTNINE)) {
+	prebuf->segs[idx] |= SEG_D;
     }
 }
 
@@ -1826,9 +2426,11 @@ void display_char(uint8_t idx, char c) {
 // displays decimals after displayable characters
 // between idx_start and idx_end, inclusive
 void display_dotselect(uint8_t idx_start, uint8_t idx_end) {
+    display_frame_t* prebuf = display_prebuf();
+
     for(uint8_t idx = idx_start; idx <= idx_end && idx < DISPLAY_SIZE; ++idx) {
-	if(display.prebuf[idx] & ~SEG_G & ~SEG_H) {
-	    display.prebuf[idx] |= DISPLAY_DOT;
+	if(prebuf->segs[idx] & ~SEG_G & ~SEG_H) {
+	    prebuf->segs[idx] |= DISPLAY_DOT;
 	}
     }
 }
@@ -1838,10 +2440,12 @@ void display_dotselect(uint8_t idx_start, uint8_t idx_end) {
 // if show is true, displays dot at specified display position (idx)
 // if show is false, clears dot at specified display position (idx)
 void display_dot(uint8_t idx, uint8_t show) {
+    display_frame_t* prebuf = display_prebuf();
+
     if(show) {
-	display.prebuf[idx] |= DISPLAY_DOT;
+	prebuf->segs[idx] |= DISPLAY_DOT;
     } else {
-	display.prebuf[idx] &= ~DISPLAY_DOT;
+	prebuf->segs[idx] &= ~DISPLAY_DOT;
     }
 }
 
@@ -1850,20 +2454,22 @@ void display_dot(uint8_t idx, uint8_t show) {
 // if show is true, displays dot separator at specified display position (idx)
 // if show is false, clears dot separator at specified display position (idx)
 void display_dotsep(uint8_t idx, uint8_t show) {
+    display_frame_t* prebuf = display_prebuf();
+
     if(show) {
-	display.dot_prebuf |= _BV(7 - idx);
+	prebuf->dots |= _BV(7 - idx);
 
 	if(display.status & DISPLAY_HIDEDOTS) {
-	    display.prebuf[idx] &= ~DISPLAY_DOT;
+	    prebuf->segs[idx] &= ~DISPLAY_DOT;
 	} else {
-	    display.prebuf[idx] |= DISPLAY_DOT;
+	    prebuf->segs[idx] |= DISPLAY_DOT;
 	}
     } else {
-	if(display.dot_prebuf & _BV(7 - idx)) {
-	    display.prebuf[idx] &= ~DISPLAY_DOT;
+	if(prebuf->dots & _BV(7 - idx)) {
+	    prebuf->segs[idx] &= ~DISPLAY_DOT;
 	}
 
-	display.dot_prebuf &= ~_BV(7 - idx);
+	prebuf->dots &= ~_BV(7 - idx);
     }
 }
 
@@ -1871,10 +2477,12 @@ void display_dotsep(uint8_t idx, uint8_t show) {
 // if show is true, displays dash at specified display position (idx)
 // if show is false, clears dash at specified display position (idx)
 void display_dash(uint8_t idx, uint8_t show) {
+    display_frame_t* prebuf = display_prebuf();
+
     if(show) {
-	display.prebuf[idx] |= DISPLAY_DASH;
+	prebuf->segs[idx] |= DISPLAY_DASH;
     } else {
-	display.prebuf[idx] &= ~DISPLAY_DASH;
+	prebuf->segs[idx] &= ~DISPLAY_DASH;
     }
 }
 
@@ -1902,7 +2510,7 @@ void display_dial(uint8_t idx, uint8_t seconds) {
 	segs |= SEG_G;
     }
 
-    display.prebuf[idx] = segs;
+    display_prebuf()->segs[idx] = segs;
 }
 
 
@@ -1931,13 +2539,7 @@ void display_transition(uint8_t type) {
 		break;
 
 	    case DISPLAY_TRANS_INSTANT:
-		    for(uint8_t i = 0; i < DISPLAY_SIZE; ++i) {
-			display.postbuf[i] = display.prebuf[i];
-		    }
-
-		    display.dot_postbuf   = display.dot_prebuf;
-		    display.colon_postbuf = display.colon_prebuf;
-
+		    display.front ^= 1;
 		    display.trans_type = DISPLAY_TRANS_NONE;
 		    break;
 
@@ -1945,4 +2547,6 @@ void display_transition(uint8_t type) {
 		break;
 	}
     }
+
+    if(type == DISPLAY_TRANS_INSTANT) display_syncprebuf();
 }
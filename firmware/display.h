@@ -2,11 +2,11 @@
 #define DISPLAY_H
 
 #include <stdint.h>        // for using standard integer types
+#include <avr/io.h>        // for using avr register names
 #include <avr/pgmspace.h>  // for accessing data in program memory
 
 #include "config.h"  // for configuration macros
-#include "temp.h"    // to compensate for timing errors
-		     // while determining temperature
+#include "system.h"  // for hot flags
 
 
 #define DISPLAY_SIZE 9
@@ -18,10 +18,12 @@
 #define DISPLAY_ZEROPAD		0x02  // zero-pad all numbers
 #define DISPLAY_ALTNINE		0x04  // alternative display for 9s
 #define DISPLAY_ALTALPHA	0x08  // alternative capital alphabet
+#define DISPLAY_HIDEDOTS	0x80  // hide flashing dot separators
+
+// display hot flags (see system.h)
 #define DISPLAY_PULSING		0x10  // display brightness pulsing
 #define DISPLAY_PULSE_DOWN	0x20  // display brightness dimming
 #define DISPLAY_DISABLED	0x40  // display disabled
-#define DISPLAY_HIDEDOTS	0x80  // hide flashing dot separators
 
 // savable settings in lower nibble of display.status
 #define DISPLAY_SETTINGS_MASK 0x0F
@@ -40,9 +42,51 @@
 #define DISPLAY_NOFLICKER_TIME 256
 #endif  // SUBSEGMENT_MULTIPLEXING
 
+#ifdef ADAPTIVE_MULTIPLEX_RATE
+#ifdef SEGMENT_MULTIPLEXING
+#error ADAPTIVE_MULTIPLEX_RATE requires digit or subdigit multiplexing
+#endif  // SEGMENT_MULTIPLEXING
+
+// brightness level (0-10) at or below which multiplexing slows
+#ifndef ADAPTIVE_MULTIPLEX_LEVEL
+#define ADAPTIVE_MULTIPLEX_LEVEL 2
+#endif  // ~ADAPTIVE_MULTIPLEX_LEVEL
+
+// longest time to display all digits when multiplexing slowly
+#ifndef ADAPTIVE_MULTIPLEX_TIME
+#define ADAPTIVE_MULTIPLEX_TIME 512  // (32 us units)
+#endif  // ~ADAPTIVE_MULTIPLEX_TIME
+#endif  // ADAPTIVE_MULTIPLEX_RATE
+
+#ifdef BOOST_LOAD_TRIM
+#ifdef OCR0A_VALUE
+#error BOOST_LOAD_TRIM requires OCR0A set from brightness (no OCR0A_VALUE)
+#endif  // OCR0A_VALUE
+
+// number of segments lit with every segment on
+#define DISPLAY_SEGMENTS_MAX (DISPLAY_SIZE * SEGMENT_COUNT)
+#endif  // BOOST_LOAD_TRIM
+
 // time between photoresister voltage samples
 #define DISPLAY_ADC_DELAY 16  // (semiticks)
 
+// photoresistor conversions summed per sample (oversampling); one
+// conversion is started per multiplexed digit, so all finish well
+// within DISPLAY_ADC_DELAY
+#define DISPLAY_ADC_SAMPLES_LOG2 4
+#define DISPLAY_ADC_SAMPLES (1 << DISPLAY_ADC_SAMPLES_LOG2)
+
+// the sum of 10-bit conversions must fit display.photo_sum
+#if DISPLAY_ADC_SAMPLES_LOG2 > 6
+#error DISPLAY_ADC_SAMPLES must not exceed 64
+#endif  // DISPLAY_ADC_SAMPLES_LOG2 > 6
+
+// photoresistor running average weight of each sample (2^-n)
+#define DISPLAY_ADC_FILTER 4
+
+// adc configuration for photoresistor conversions (ADSC not set)
+#define DISPLAY_ADCSRA (_BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1))
+
 // disabled flag for display.off_hour
 #define DISPLAY_NOOFF 0x80
 
@@ -63,30 +107,125 @@ enum {
 #define DISPLAY_TRANS_LR_DELAY 20  // (semiticks)
 #define DISPLAY_TRANS_UD_DELAY 50  // (semiticks)
 
-// duration of blinking dot times
-#define DISPLAY_DOTFLASH_SLOW_TIME  768  // (semiticks)
-#define DISPLAY_DOTFLASH_FAST_TIME  384  // (semiticks)
+#ifdef DISPLAY_MARQUEE
+// marquee status flags for display.marquee_flags
+#define DISPLAY_MARQUEE_PSTR	0x01  // marquee text in program memory
+
+// duration of each marquee step (one character)
+#ifndef DISPLAY_MARQUEE_DELAY
+#define DISPLAY_MARQUEE_DELAY 192  // (semiticks)
+#endif  // ~DISPLAY_MARQUEE_DELAY
+
+// display.marquee_timer holds one step
+#if DISPLAY_MARQUEE_DELAY > 255
+#error DISPLAY_MARQUEE_DELAY must not exceed 255
+#endif  // DISPLAY_MARQUEE_DELAY > 255
+#endif  // DISPLAY_MARQUEE
+
+// animation tracks; display_semitick() steps each running track
+// when its next keyframe is due
+enum {
+    DISPLAY_ANIM_COLONS,  // animated colon frames
+    DISPLAY_ANIM_DOTS,    // blinking dot separators
+    DISPLAY_ANIM_PULSE,   // pulsing brightness
+    DISPLAY_ANIM_COUNT,
+};
+
+
+// the multiplexing timer is kept in a general purpose i/o register
+// so the timer0 overflow fast path (icetube.c) can test it cheaply;
+// digit times are counted in timer0 overflows, so overflows lost
+// while interrupts are masked for over 32 us stretch the digit
+#define DISPLAY_MULTIPLEX_DIV GPIOR2
+
+
+#ifdef VFD_TO_SPEC
+// filament drive waveform:  PC2 and PC3 levels for each step, with
+// one step every FILAMENT_FREQUENCY_DIV timer0 overflows; reduced
+// voltages insert steps with both pins low (see config.h)
+#define FILAMENT_OFF  0
+#define FILAMENT_FWD  _BV(PC3)  // current flows right to left
+#define FILAMENT_REV  _BV(PC2)  // current flows left to right
+#define FILAMENT_MASK (FILAMENT_FWD | FILAMENT_REV)
+
+#if defined(FILAMENT_CURRENT_DC_FWD)
+#if defined(FILAMENT_VOLTAGE_3_3)
+#define FILAMENT_STEPS 3
+#define FILAMENT_WAVEFORM FILAMENT_FWD, FILAMENT_FWD, FILAMENT_OFF
+#elif defined(FILAMENT_VOLTAGE_2_5)
+#define FILAMENT_STEPS 2
+#define FILAMENT_WAVEFORM FILAMENT_FWD, FILAMENT_OFF
+#else  // ~FILAMENT_VOLTAGE_3_3 && ~FILAMENT_VOLTAGE_2_5
+#define FILAMENT_STEPS 1
+#define FILAMENT_WAVEFORM FILAMENT_FWD
+#endif  // FILAMENT_VOLTAGE_*
+#elif defined(FILAMENT_CURRENT_DC_REV)
+#if defined(FILAMENT_VOLTAGE_3_3)
+#define FILAMENT_STEPS 3
+#define FILAMENT_WAVEFORM FILAMENT_REV, FILAMENT_REV, FILAMENT_OFF
+#elif defined(FILAMENT_VOLTAGE_2_5)
+#define FILAMENT_STEPS 2
+#define FILAMENT_WAVEFORM FILAMENT_REV, FILAMENT_OFF
+#else  // ~FILAMENT_VOLTAGE_3_3 && ~FILAMENT_VOLTAGE_2_5
+#define FILAMENT_STEPS 1
+#define FILAMENT_WAVEFORM FILAMENT_REV
+#endif  // FILAMENT_VOLTAGE_*
+#else  // ~FILAMENT_CURRENT_DC_FWD && ~FILAMENT_CURRENT_DC_REV
+#if defined(FILAMENT_VOLTAGE_3_3)
+#define FILAMENT_STEPS 3
+#define FILAMENT_WAVEFORM FILAMENT_FWD, FILAMENT_REV, FILAMENT_OFF
+#elif defined(FILAMENT_VOLTAGE_2_5)
+#define FILAMENT_STEPS 4
+#define FILAMENT_WAVEFORM FILAMENT_REV, FILAMENT_OFF, \
+			  FILAMENT_FWD, FILAMENT_OFF
+#else  // ~FILAMENT_VOLTAGE_3_3 && ~FILAMENT_VOLTAGE_2_5
+#define FILAMENT_STEPS 2
+#define FILAMENT_WAVEFORM FILAMENT_REV, FILAMENT_FWD
+#endif  // FILAMENT_VOLTAGE_*
+#endif  // FILAMENT_CURRENT_DC_*
+
+#ifndef FILAMENT_FREQUENCY_DIV
+#define FILAMENT_FREQUENCY_DIV 1
+#endif  // ~FILAMENT_FREQUENCY_DIV
+#endif  // VFD_TO_SPEC
+
+
+// display contents:  segments for each digit, and bitmasks of the
+// digits showing dot separators and animated colons
+typedef struct {
+    uint8_t segs[DISPLAY_SIZE];  // segments for each digit
+    uint8_t dots;                // bitmask for dot indexes
+    uint8_t colons;              // bitmask for colon indexes
+} display_frame_t;
 
 
 typedef struct {
     uint8_t status;                 // display status flags
 
-    uint8_t multiplex_div;	    // the multiplexing timer
     uint8_t trans_type;             // current transition type
     uint8_t trans_timer;            // current transition timer
-    uint8_t prebuf[DISPLAY_SIZE];   // future display contents
-    uint8_t postbuf[DISPLAY_SIZE];  // current display contents
+    uint8_t front;                  // display_frames index displayed
 
-    int16_t  colon_timer;	    // transition timer for colon animations
-    uint8_t  colon_prebuf;	    // bitmask for future colon indexes
-    uint8_t  colon_postbuf;	    // bitmask for future colon indexes
     uint8_t  colon_style_idx;	    // the selected colon style index
     uint16_t colon_frame;	    // current colon frame data
     uint8_t  colon_frame_idx;	    // current colon frame index
 
-    int16_t  dot_timer;		    // transition timer for blinking dots
-    uint8_t  dot_prebuf;	    // bitmask for future dot indexes
-    uint8_t  dot_postbuf;	    // bitmask for current dot indexes
+    uint8_t  dot_frame_idx;	    // next blinking dot frame index
+
+    // animation engine:  each running track is next due anim_delay
+    // semiticks after the engine last woke; the engine wakes again
+    // when anim_wait counts down, anim_span semiticks after last woken
+    uint8_t  anim_active;  // bit set for each running track
+    uint16_t anim_wait;    // semiticks until next wake (0 if idle)
+    uint16_t anim_span;    // semiticks between last and next wake
+    uint16_t anim_delay[DISPLAY_ANIM_COUNT];  // when each track is due
+
+#ifdef DISPLAY_MARQUEE
+    const char* marquee_text;  // next marquee character (null if idle)
+    uint8_t marquee_flags;     // marquee status flags
+    uint8_t marquee_tail;      // blanks left to scroll text off display
+    uint8_t marquee_timer;     // semiticks until next marquee step
+#endif  // DISPLAY_MARQUEE
 
 #ifdef AUTOMATIC_DIMMER
     int8_t  bright_min;             // minimum display brightness
@@ -99,6 +238,11 @@ typedef struct {
     // photoresistor adc result (times 2^6, running average)
     uint16_t photo_avg;
 
+    // sum of photoresistor conversions for next sample
+    // and number of conversions remaining (set by ADC_vect)
+    uint16_t photo_sum;
+    uint8_t  photo_conv;
+
     // current brightness level from photoresistor
     // (truncated to [0, 80] for actual display brightness)
     int16_t photo_idx;
@@ -119,15 +263,14 @@ typedef struct {
     uint8_t off_days;  // disable display on given days
     uint8_t on_days;   // ignore off time on given days
 
-    // when display is disabled, any button press enables the display
-    // for DISPLAY_OFF_TIMEOUT seconds.  off_timer stores the number
-    // of seconds before the display may be disabled after a button press.
-    uint8_t off_timer;
+#ifdef BOOST_LOAD_TRIM
+    uint8_t boost_base;    // OCR0A for brightness before load trim
+    uint8_t lit_segments;  // segments lit in displayed frame
+#endif  // BOOST_LOAD_TRIM
 
 #ifdef VFD_TO_SPEC
-    uint8_t filament_timer;   // timer for generating filament current
+    uint8_t filament_step;    // current step of filament waveform
     uint8_t filament_div;     // divider counter for filament frequency
-    uint8_t filament_div_max; // max value for divider counter
 
 #ifndef OCR0B_PWM_DISABLE
     uint8_t OCR0B_value;
@@ -138,11 +281,32 @@ typedef struct {
     // length of time to display each digit (32 microsecond units)
     uint8_t digit_times[DISPLAY_SIZE];
     uint8_t digit_time_shift;  // flicker reduction adjustment
+#ifdef ADAPTIVE_MULTIPLEX_RATE
+    uint8_t dim;  // true if dim enough to multiplex slowly
+#endif  // ADAPTIVE_MULTIPLEX_RATE
 #endif  // ~SEGMENT_MULTIPLEXING
 } display_t;
 
 volatile extern display_t display;
 
+// the displayed frame (postbuf) and the frame being drawn (prebuf);
+// transitions flip display.front, so only the front frame is shown
+extern display_frame_t display_frames[2];
+
+// returns the frame being displayed
+static inline display_frame_t* display_postbuf(void) {
+    return &(display_frames[display.front]);
+}
+
+// returns the frame being drawn, displayed after the next transition
+static inline display_frame_t* display_prebuf(void) {
+    return &(display_frames[display.front ^ 1]);
+}
+
+#ifdef VFD_TO_SPEC
+extern const uint8_t display_filament[FILAMENT_STEPS] PROGMEM;
+#endif  // VFD_TO_SPEC
+
 
 void display_init(void);
 void display_wake(void);
@@ -156,157 +320,26 @@ void display_on(void);
 uint8_t display_varsemitick(void);
 void display_semitick(void);
 
-// toggle push-pull outputs to generate alternating current on vfd fillament
+// multiplex display and step filament waveform on every timer0 overflow
 static inline void display_semisemitick(void) {
-    // multiplex the display
-    if(display.multiplex_div && !--display.multiplex_div) {
-	display.multiplex_div = display_varsemitick();
-    }
-#ifdef TEMPERATURE_SENSOR
-    while(temp.missed_ovf) {
-	--temp.missed_ovf;
-	if(display.multiplex_div && !--display.multiplex_div) {
-	    display.multiplex_div = display_varsemitick();
-	}
+    // multiplex the display; while the display is disabled the
+    // divider stays at zero, which stops multiplexing until
+    // display_on() restarts it
+    if(DISPLAY_MULTIPLEX_DIV && !--DISPLAY_MULTIPLEX_DIV
+	    && !HOTFLAG_TEST(DISPLAY_DISABLED)) {
+	DISPLAY_MULTIPLEX_DIV = display_varsemitick();
     }
-#endif  // TEMPERATURE_SENSOR
-
-    // generate ac-filament current as required
-#if defined(VFD_TO_SPEC)
-    if(!(display.status & DISPLAY_DISABLED)) {
-	if( display.filament_div && !--display.filament_div ) {
-#if defined(FILAMENT_CURRENT_DC_FWD)
-#if defined(FILAMENT_VOLTAGE_3_3)
-	    switch(display.filament_timer) {
-		case 0:
-		    PORTC &= ~_BV(PC2);
-		    PORTC |=  _BV(PC3);
-		case 1:
-		    ++display.filament_timer;
-		    break;
-		default:
-		    PORTC &= ~_BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    display.filament_timer = 0;
-		    break;
-	    }
-#elif defined(FILAMENT_VOLTAGE_2_5) // && !defined(FILAMENT_VOLTAGE_3_3)
-	    switch(display.filament_timer) {
-		case 0:
-		    PORTC &= ~_BV(PC2);
-		    PORTC |=  _BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		default:
-		    PORTC &= ~_BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    display.filament_timer = 0;
-		    break;
-	    }
-#else  // ~FILAMENT_VOLTAGE_3_3 && ~FILAMENT_VOLTAGE_2_5 
-	    PORTC &= ~_BV(PC2);
-	    PORTC |=  _BV(PC3);
-#endif  // FILAMENT_VOLTAGE_*
-
-#elif defined(FILAMENT_CURRENT_DC_REV) // && !defined(FILAMENT_CURRENT_DC_FWD)
+#if defined(VFD_TO_SPEC) && FILAMENT_STEPS > 1
+    // advance filament waveform; both pins change in one write
+    if(!HOTFLAG_TEST(DISPLAY_DISABLED) && !--display.filament_div) {
+	display.filament_div = FILAMENT_FREQUENCY_DIV;
 
-#if defined(FILAMENT_VOLTAGE_3_3)
-	    switch(display.filament_timer) {
-		case 0:
-		    PORTC |=  _BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		case 1:
-		    ++display.filament_timer;
-		    break;
-		default:
-		    PORTC &= ~_BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    display.filament_timer = 0;
-		    break;
-	    }
-#elif defined(FILAMENT_VOLTAGE_2_5) // && !defined(FILAMENT_VOLTAGE_3_3)
-	    switch(display.filament_timer) {
-		case 0:
-		    PORTC |=  _BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		default:
-		    PORTC &= ~_BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    display.filament_timer = 0;
-		    break;
-	    }
-#else  // ~FILAMENT_VOLTAGE_3_3 && ~FILAMENT_VOLTAGE_2_5 
-	    PORTC |=  _BV(PC2);
-	    PORTC &= ~_BV(PC3);
-#endif  // FILAMENT_VOLTAGE_*
-
-#else  // ~FLIAMENT_CURRENT_DC_REV && ~FILAMENT_CURRENT_DC_FWD
-
-#ifdef FILAMENT_VOLTAGE_3_3
-	    switch(display.filament_timer) {
-		case 0:
-		    PORTC &= ~_BV(PC2);
-		    PORTC |=  _BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		case 1:
-		    PORTC |=  _BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		default:
-		    PORTC &= ~_BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    display.filament_timer = 0;
-		    break;
-	    }
-#elif defined(FILAMENT_VOLTAGE_2_5) // && !defined(FILAMENT_VOLTAGE_3_3)
-	    switch(display.filament_timer) {
-		case 0:
-		    PORTC |=  _BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		case 1:
-		    PORTC &= ~_BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		case 2:
-		    PORTC &= ~_BV(PC2);
-		    PORTC |=  _BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		default:
-		    PORTC &= ~_BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    display.filament_timer = 0;
-		    break;
-	    }
-#else // ~FILAMENT_VOLTAGE_3_3 && ~FILAMENT_VOLTAGE_2_5
-	    switch(display.filament_timer) {
-		case 0:
-		    PORTC |=  _BV(PC2);
-		    PORTC &= ~_BV(PC3);
-		    ++display.filament_timer;
-		    break;
-		default:
-		    PORTC &= ~_BV(PC2);
-		    PORTC |=  _BV(PC3);
-		    display.filament_timer = 0;
-		    break;
-	    }
-#endif  // FILAMENT_VOLTAGE_3_3
-#endif // FILAMENT_CURRENT_DC_*
-
-#ifdef FILAMENT_FREQUENCY_DIV
-	    display.filament_div = FILAMENT_FREQUENCY_DIV;
-#else  // ~FILAMENT_FREQUENCY_DIV
-	    display.filament_div = 1;
-#endif // FILAMENT_FREQUENCY_DIV
+	if(++display.filament_step == FILAMENT_STEPS) {
+	    display.filament_step = 0;
 	}
+
+	PORTC = (PORTC & ~FILAMENT_MASK)
+	      | pgm_read_byte(&(display_filament[display.filament_step]));
     }
 #endif  // VFD_TO_SPEC
 }
@@ -350,16 +383,34 @@ uint8_t display_onbutton(void);
 
 void display_autodim(void);
 void display_setbrightness(int8_t level);
+#ifdef BOOST_LOAD_TRIM
+void display_trimboost(void);
+#endif  // BOOST_LOAD_TRIM
 
 void display_pstr(const uint8_t idx, PGM_P pstr);
+#ifdef DISPLAY_MARQUEE
+void display_marquee_pstr(PGM_P pstr);
+void display_marquee_str(const char* str);
+void display_marquee_stop(void);
+
+// returns true while marquee text is scrolling
+static inline uint8_t display_marquee_active(void) {
+    return display.marquee_text != 0;
+}
+#endif  // DISPLAY_MARQUEE
 void display_digit(uint8_t idx, uint8_t n);
 void display_twodigit_rightadj(uint8_t idx, int8_t n);
 void display_twodigit_leftadj(uint8_t idx, int8_t n);
 void display_twodigit_zeropad(uint8_t idx, int8_t n);
+#ifdef TIME_BCD
+void display_twodigit_bcd_rightadj(uint8_t idx, uint8_t bcd);
+void display_twodigit_bcd_zeropad(uint8_t idx, uint8_t bcd);
+#endif  // TIME_BCD
 void display_char(uint8_t idx, char c);
 void display_clear(uint8_t idx);
 
 void display_clearall(void);
+uint8_t display_changed(void);
 void display_dotselect(uint8_t idx_start, uint8_t idx_end);
 void display_dot(uint8_t idx, uint8_t show);
 void display_dotsep(uint8_t idx, uint8_t show);
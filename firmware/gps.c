@@ -1,5 +1,9 @@
 // gps.c  --  parses gps output from usart and sets time accordingly
 //
+//    RXD (PD0)    gps data input (via usart.c)
+//    PB4*         gps pulse-per-second input
+//
+// * PB4 is only used when GPS_PPS is defined.
 //
 
 
@@ -12,10 +16,12 @@
 #include <util/atomic.h>    // for non-interruptable blocks
 
 #include "gps.h"
+#include "profile.h"  // for profiling atomic blocks
 #include "time.h"
 #include "usart.h"
 #include "alarm.h"
 #include "mode.h"
+#include "timer.h"
 
 
 #define FIELD_RECORD_START                  0
@@ -60,10 +66,18 @@ void gps_wake(void) {
     UCSR0B |= _BV(RXCIE0);
 
     // give gps time to acquire signal before issuing "gps lost" warning
-    gps.warn_timer = GPS_WARN_TIMEOUT;
+    timer_start(TIMER_GPS_WARN, GPS_WARN_TIMEOUT, 0, 0);
 
     // gps needs to reacquire satellites
     gps.status &= ~GPS_SIGNAL_GOOD;
+
+#ifdef GPS_PPS
+    // enable pin change interrupt on pulse-per-second input
+    DDRB   &= ~_BV(PB4);
+    PCMSK0 |=  _BV(PCINT4);
+    PCIFR   =  _BV(PCIF0);
+    PCICR  |=  _BV(PCIE0);
+#endif  // GPS_PPS
 }
 
 
@@ -71,19 +85,94 @@ void gps_wake(void) {
 void gps_sleep(void) {
     // disable usart rx interrupt
     UCSR0B &= ~_BV(RXCIE0);
+
+#ifdef GPS_PPS
+    // disable pulse-per-second interrupt and loop
+    PCICR  &= ~_BV(PCIE0);
+    PCMSK0 &= ~_BV(PCINT4);
+    timer_stop(TIMER_GPS_PPS);
+    gps.pps_status = 0;
+#endif  // GPS_PPS
 }
 
 
-// decrement gps timers
-void gps_tick(void) {
-    if(gps.data_timer) {
-	--gps.data_timer;
-    } else {
-	gps.status &= ~GPS_SIGNAL_GOOD;
+// called when gps data stops arriving
+void gps_datatimeout(void) {
+    gps.status &= ~GPS_SIGNAL_GOOD;
+}
+
+
+#ifdef GPS_PPS
+// called when pulse-per-second input stops arriving
+void gps_ppstimeout(void) {
+    gps.pps_status = 0;
+}
+#endif  // GPS_PPS
+
+
+#ifdef GPS_PPS
+// runs phase-locked loop once per second from time_tick();
+// returns the number of 1/128 seconds to lengthen the next second
+int8_t gps_pll_tick(void) {
+    // no correction without recent pulses
+    if(!timer_active(TIMER_GPS_PPS)) {
+	gps.pll_accum = 0;
+	return 0;
+    }
+
+    if(gps.pps_status & GPS_PPS_NEW) {
+	gps.pps_status &= ~GPS_PPS_NEW;
+
+	int8_t phase = gps.pps_phase;
+
+	// only adjust frequency when nearly locked to prevent
+	// large initial phase errors from winding up the loop
+	if(-GPS_PPS_LOCK_PHASE <= phase && phase <= GPS_PPS_LOCK_PHASE) {
+	    gps.pps_status |= GPS_PPS_LOCKED;
+
+	    gps.pll_freq += phase * GPS_PLL_FREQ_GAIN;
+	    if(gps.pll_freq >  GPS_PLL_FREQ_MAX) gps.pll_freq =  GPS_PLL_FREQ_MAX;
+	    if(gps.pll_freq < -GPS_PLL_FREQ_MAX) gps.pll_freq = -GPS_PLL_FREQ_MAX;
+	} else {
+	    gps.pps_status &= ~GPS_PPS_LOCKED;
+	}
+
+	gps.pll_accum += (int32_t)phase * GPS_PLL_PHASE_GAIN;
+    }
+
+    gps.pll_accum += gps.pll_freq;
+
+    // apply whole 1/128 seconds of pending correction
+    int16_t adj = gps.pll_accum >> 16;
+    if(adj >  GPS_PLL_SLEW_MAX) adj =  GPS_PLL_SLEW_MAX;
+    if(adj < -GPS_PLL_SLEW_MAX) adj = -GPS_PLL_SLEW_MAX;
+    gps.pll_accum -= (int32_t)adj << 16;
+
+#ifndef AUTODRIFT_CONSTANT
+    // record each whole second of correction as if the time were set,
+    // so the drift correction learns the crystal error
+    gps.pll_ticks += adj;
+    if(gps.pll_ticks >= 64 || gps.pll_ticks <= -64) {
+	if(gps.pll_ticks > 0) {
+	    // lengthened seconds: clock was set back
+	    gps.pll_ticks -= 128;
+	    --time.drift_delta_seconds;
+	} else {
+	    // shortened seconds: clock was set forward
+	    gps.pll_ticks += 128;
+	    ++time.drift_delta_seconds;
+	}
+
+	if(!timer_active(TIMER_DRIFT_DELAY)) {
+	    timer_start(TIMER_DRIFT_DELAY, TIME_DRIFT_SAVE_DELAY, 0,
+			time_driftdelay);
+	}
     }
+#endif  // ~AUTODRIFT_CONSTANT
 
-    if(gps.warn_timer) --gps.warn_timer;
+    return adj;
 }
+#endif  // GPS_PPS
 
 
 // load time offsets from gmt/utc from eeprom
@@ -113,10 +202,10 @@ void gps_settime(void) {
     // only set time once per rmc sentence
     gps.status &= GPS_SIGNAL_GOOD;
 
-    gps.data_timer = GPS_DATA_TIMEOUT;
+    timer_start(TIMER_GPS_DATA, GPS_DATA_TIMEOUT, 0, gps_datatimeout);
 
     if(gps.status_code == 'A') {
-	gps.warn_timer = GPS_WARN_TIMEOUT;
+	timer_start(TIMER_GPS_WARN, GPS_WARN_TIMEOUT, 0, 0);
 
 	if(!(gps.status & GPS_SIGNAL_GOOD)) {
 	    // don't set time on first good gps signal;
@@ -188,6 +277,19 @@ void gps_settime(void) {
 	    time_diff += (int32_t)24 * 60 * 60;
 	}
 
+#ifdef GPS_PPS
+	if(gps.pps_status & GPS_PPS_LOCKED) {
+	    // when locked to pulse-per-second, the clock second starts
+	    // with the gps second, so correct any whole-second error
+	    // while preserving fractional seconds
+	    if(time_diff) {
+		time_frac_t now;
+		time_now_frac(&now);
+		time_settime_frac(hour, minute, second, now.frac);
+		mode_tick();  // refresh display to show new time
+	    }
+	} else
+#endif  // GPS_PPS
 	if(time_diff && time_diff != 1) {
 	    // note: this code will never be called if near an alarm
 	    // time, so we don't have to worry about missing an alarm
@@ -208,6 +310,29 @@ void gps_settime(void) {
 }
 
 
+#ifdef GPS_PPS
+// measure clock phase at the rising edge of each gps pulse
+ISR(PCINT0_vect) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	if(!(PINB & _BV(PB4))) return;  // ignore falling edge
+
+	// timer2 counts 1/128 seconds since the clock second started,
+	// so small counts mean the clock is ahead of the pulse and
+	// counts near the top mean the clock is behind
+	uint8_t count = TCNT2;
+	if(count < 64) {
+	    gps.pps_phase = count;
+	} else {
+	    gps.pps_phase = count - OCR2A - 1;
+	}
+
+	gps.pps_status |= GPS_PPS_NEW;
+	timer_start(TIMER_GPS_PPS, GPS_PPS_TIMEOUT, 0, gps_ppstimeout);
+    }
+}
+#endif  // GPS_PPS
+
+
 // parse character from gps
 ISR(USART_RX_vect) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
@@ -5,6 +5,14 @@
 
 #include "config.h"  // for configuration macros
 
+#if defined(GPS_PPS) && !defined(GPS_TIMEKEEPING)
+#error GPS_PPS requires GPS_TIMEKEEPING
+#endif
+
+#if defined(GPS_PPS) && defined(VFD_TO_SPEC) && !defined(XMAS_DESIGN)
+#error GPS_PPS input pin (PB4) is used by VFD_TO_SPEC
+#endif
+
 #ifdef GPS_TIMEKEEPING
 
 // various flags for gps.status
@@ -26,7 +34,7 @@
 #endif
 
 
-// timeout values for gps.data_timer and gps.warn_timer
+// timeout values for TIMER_GPS_DATA and TIMER_GPS_WARN
 #define GPS_DATA_TIMEOUT  15  // (seconds)
 #define GPS_WARN_TIMEOUT 180  // (seconds)
 
@@ -34,6 +42,20 @@
 #define GPS_HOUR_OFFSET_MIN -12
 #define GPS_HOUR_OFFSET_MAX  14
 
+#ifdef GPS_PPS
+// flags for gps.pps_status
+#define GPS_PPS_NEW    0x01  // new phase measurement in gps.pps_phase
+#define GPS_PPS_LOCKED 0x02  // phase error within GPS_PPS_LOCK_PHASE
+
+// pulse-per-second timeout and phase-locked loop parameters
+#define GPS_PPS_TIMEOUT     3     // (seconds)
+#define GPS_PPS_LOCK_PHASE  4     // 1/128 seconds
+#define GPS_PLL_PHASE_GAIN  8192  // 1/65536 (1/8 of phase error per second)
+#define GPS_PLL_FREQ_GAIN   256   // 1/65536 (1/256 of phase error per second)
+#define GPS_PLL_FREQ_MAX    1678  // 1/65536 ticks per second (~200 ppm)
+#define GPS_PLL_SLEW_MAX    16    // 1/128 seconds per second
+#endif  // GPS_PPS
+
 
 typedef struct {
     uint8_t status;    // rmc parse status flags
@@ -54,9 +76,14 @@ typedef struct {
     int8_t rel_utc_hour;
     int8_t rel_utc_minute;
 
-    // gps data-received timers to determine if gps present with good signal
-    uint8_t data_timer;  // nonzero if gps data is being received
-    uint8_t warn_timer;  // nonzero if gps has signal (status_code == 'A')
+#ifdef GPS_PPS
+    uint8_t pps_status;  // pulse-per-second status flags
+    int8_t  pps_phase;   // 1/128 seconds clock is ahead of last pulse
+
+    int16_t pll_freq;    // frequency correction (1/65536 ticks per second)
+    int32_t pll_accum;   // pending correction (1/65536 ticks)
+    int8_t  pll_ticks;   // correction not yet recorded as drift (1/128 s)
+#endif  // GPS_PPS
 } gps_t;
 
 
@@ -68,14 +95,21 @@ void gps_init(void);
 void gps_wake(void);
 void gps_sleep(void);
 
-void gps_tick(void);
+static inline void gps_tick(void) {};
 static inline void gps_semitick(void) {};
 
+void gps_datatimeout(void);
+
 void gps_loadrelutc(void);
 void gps_saverelutc(void);
 
 void gps_settime(void);
 
+#ifdef GPS_PPS
+void gps_ppstimeout(void);
+int8_t gps_pll_tick(void);
+#endif  // GPS_PPS
+
 #else  // GPS_TIMEKEEPING
 
 static inline void gps_init(void) {};
@@ -28,6 +28,7 @@
 // headers for this project
 #include "config.h"
 #include "system.h"
+#include "timer.h"
 #include "time.h"
 #include "alarm.h"
 #include "piezo.h"
@@ -37,6 +38,7 @@
 #include "usart.h"
 #include "gps.h"
 #include "temp.h"
+#include "profile.h"
 
 
 // define ATmega328p/ATmega328 lock bits
@@ -64,10 +66,6 @@ FUSES = {
 uint8_t ee_unreliable_byte EEMEM = 0;
 
 
-// set to 1 every ~1 millisecond or so
-uint8_t semitick_successful = 1;
-
-
 // start everything for the first time
 int main(void) {
     cli();  // disable interrupts until system initialized
@@ -76,6 +74,8 @@ int main(void) {
     // the system in a low-power configuration
     system_init();
     usart_init();
+    timer_init();
+    profile_init();
     time_init();
     buttons_init();
     alarm_init();
@@ -114,8 +114,8 @@ int main(void) {
     piezo_setvolume(3, 0);
     piezo_beep(500);
 
-    // clock function is entirelly interrupt-driven after
-    // this point, so let the system idle indefinetly
+    // interrupts raise events after this point, so let the
+    // system dispatch them and otherwise idle indefinetly
     system_idle_loop();
 }
 
@@ -124,62 +124,131 @@ int main(void) {
 // timer2 is clocked by the clock crystal and triggered once per second
 ISR(TIMER2_COMPB_vect) {
     NONATOMIC_BLOCK(NONATOMIC_FORCEOFF) {
-	if(system.status & SYSTEM_SLEEP) {
+	if(HOTFLAG_TEST(SYSTEM_SLEEP)) {
 	    wdt_reset();
 
 	    system_tick();
 	    time_tick();
+	    timer_tick();
 	    alarm_tick();
 	    piezo_tick();
 	    temp_tick();
 	} else {
-	    if(semitick_successful) wdt_reset();
-	    semitick_successful = 0;
-
 	    system_tick();
 	    time_tick();
-	    buttons_tick();
-	    alarm_tick();
-	    piezo_tick();
-	    mode_tick();
-	    display_tick();
-	    gps_tick();
-	    usart_tick();
-	    temp_tick();
+
+	    // remaining tick functions run from system_idle_loop()
+	    if(system.ticks != UINT8_MAX) ++system.ticks;
 	}
     }
 }
 
 
+#if defined(VFD_TO_SPEC) && FILAMENT_STEPS > 1
+// filament waveform may step on any overflow, so the full
+// handler below must run every time
+#define TIMER0_OVF_FULL_vect TIMER0_OVF_vect
+#else
+// full handler below is entered from the fast path
+#define TIMER0_OVF_FULL_vect __vector_timer0_ovf_full
+
+
 // timer0 overflow interrupt
 // triggered every 32 microseconds (31.25 khz);
 // pwm output from timer0 controls boost power
-ISR(TIMER0_OVF_vect) {
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	// display code needs additional control over multiplexing
-	display_semisemitick();
-
-	// interupt just returns 31 out of 32 times
-	static uint8_t semicounter = 1;
-	if(semicounter && !--semicounter) {
-	    NONATOMIC_BLOCK(NONATOMIC_FORCEOFF) {
-		// code below runs every "semisecond" or
-		// every 1.02 microseconds (0.98 khz)
-		system_semitick();
-		time_semitick();
-		buttons_semitick();
-		alarm_semitick();
-		piezo_semitick();
-		mode_semitick();
-		display_semitick();
-		gps_semitick();
-		usart_semitick();
-		temp_semitick();
-
-		semitick_successful = 1;
-		semicounter = 32;
-	    }
-	}
+//
+// 31 of 32 overflows only count down the semitick counter and
+// the multiplexing divider, so this fast path saves only r24 and
+// SREG, counts down both and returns (~40 cycles including entry
+// and reti); when either count expires, a semitick is awaiting
+// dispatch, or a 1-Wire transaction is in progress, it jumps to the
+// full handler instead without changing anything
+//
+// cycle counts from the instruction timings (not measured): 7 to
+// enter (interrupt response and vector jmp), 5 to save r24 and SREG,
+// 7 for the semitick tests, 4 for the 1-Wire test, 7 to count down
+// the multiplexing divider (6 if stopped), 3 to count down the
+// semitick counter, and 9 to restore and reti; so 38 cycles per fast
+// overflow (42 with TEMPERATURE_SENSOR), of which 21 are interrupt
+// entry, reti, and saving registers; jumping to the full handler
+// costs 17 to 24 cycles (28 with TEMPERATURE_SENSOR) before the
+// full handler's own prologue
+ISR(TIMER0_OVF_vect, ISR_NAKED) {
+    asm volatile(
+	"push r24"                "\n\t"
+	"in   r24, __SREG__"      "\n\t"
+	"push r24"                "\n\t"
+
+	// semitick counter expiring or semitick awaiting dispatch?
+	"in   r24, %[semicounter]" "\n\t"
+	"cpi  r24, 1"             "\n\t"
+	"breq 2f"                 "\n\t"
+	"lds  r24, %[semiticks]"  "\n\t"
+	"tst  r24"                "\n\t"
+	"brne 2f"                 "\n\t"
+
+#ifdef TEMPERATURE_SENSOR
+	// 1-Wire transaction in progress?
+	"lds  r24, %[ow_state]"   "\n\t"
+	"tst  r24"                "\n\t"
+	"brne 2f"                 "\n\t"
+#endif  // TEMPERATURE_SENSOR
+
+	// multiplexing divider expiring? (zero is stopped)
+	"in   r24, %[mux_div]"    "\n\t"
+	"cpi  r24, 1"             "\n\t"
+	"breq 2f"                 "\n\t"
+	"tst  r24"                "\n\t"
+	"breq 1f"                 "\n\t"
+	"dec  r24"                "\n\t"
+	"out  %[mux_div], r24"    "\n\t"
+	"1:"                      "\n\t"
+
+	// nothing due: count down semitick counter and return
+	"in   r24, %[semicounter]" "\n\t"
+	"dec  r24"                "\n\t"
+	"out  %[semicounter], r24" "\n\t"
+	"pop  r24"                "\n\t"
+	"out  __SREG__, r24"      "\n\t"
+	"pop  r24"                "\n\t"
+	"reti"                    "\n\t"
+
+	// work due: restore registers and run full handler
+	"2:"                      "\n\t"
+	"pop  r24"                "\n\t"
+	"out  __SREG__, r24"      "\n\t"
+	"pop  r24"                "\n\t"
+	"jmp  __vector_timer0_ovf_full" "\n\t"
+	:
+	: [semicounter] "I" (_SFR_IO_ADDR(SYSTEM_SEMICOUNTER)),
+	  [mux_div]     "I" (_SFR_IO_ADDR(DISPLAY_MULTIPLEX_DIV)),
+#ifdef TEMPERATURE_SENSOR
+	  [ow_state]    "i" (&temp.ow_state),
+#endif  // TEMPERATURE_SENSOR
+	  [semiticks]   "i" (&system.semiticks)
+    );
+}
+#endif  // VFD_TO_SPEC && FILAMENT_STEPS > 1
+
+
+// full timer0 overflow handler
+ISR(TIMER0_OVF_FULL_vect) {
+    // display code needs additional control over multiplexing
+    display_semisemitick();
+
+    // 1-Wire timeslots are timed by timer0 overflows
+    temp_semisemitick();
+
+    // age oldest pending semitick to measure dispatch latency
+    if(system.semiticks && system.semitick_age != UINT8_MAX) {
+	++system.semitick_age;
+    }
+
+    // raise a semitick event 1 out of 32 times;
+    // semitick functions run from system_idle_loop()
+    if(!--SYSTEM_SEMICOUNTER) {
+	if(system.semiticks != UINT8_MAX) ++system.semiticks;
+	SYSTEM_SEMICOUNTER = SYSTEM_SEMITICK_OVERFLOWS;
     }
 }
 
@@ -191,7 +260,7 @@ ISR(ANALOG_COMP_vect) {
     cli();  // prevent nested interrupts
 
     // if the system is already sleeping, do nothing
-    if(system.status & SYSTEM_SLEEP) return;
+    if(HOTFLAG_TEST(SYSTEM_SLEEP)) return;
 
     // if power is good, do nothing
     if(system_power() == SYSTEM_ADAPTOR) return;
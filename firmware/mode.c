@@ -10,6 +10,7 @@
 #include <stdio.h>        // for using the NULL pointer macro
 
 #include "mode.h"
+#include "profile.h"  // for profiling atomic blocks
 #include "system.h"   // for system.initial_mcusr
 #include "display.h"  // for setting display contents
 #include "time.h"     // for displaying and setting time and date
@@ -17,10 +18,22 @@
 #include "piezo.h"    // for making clicks and alarm sounds
 #include "buttons.h"  // for processing button presses
 #include "gps.h"      // for setting the utc offset
+#include "temp.h"     // for displaying temperature
+#include "timer.h"    // for gps signal timers
 #include "usart.h"    // for debugging output
 
 #define BLINK_OFF_SEMITICKS 128
 
+// whether a status message replaces the time this second, and
+// which of its brief or full texts is kept in program memory
+#ifdef DISPLAY_MARQUEE
+#define MODE_MESSAGE_DUE (time.second % MODE_MARQUEE_INTERVAL == 1)
+#define MODE_MESSAGE(brief, full) PSTR(full)
+#else
+#define MODE_MESSAGE_DUE (time.second & 0x01)
+#define MODE_MESSAGE(brief, full) PSTR(brief)
+#endif  // DISPLAY_MARQUEE
+
 
 // extern'ed clock mode data
 volatile mode_t mode;
@@ -28,8 +41,10 @@ volatile mode_t mode;
 
 // private function declarations
 void mode_update(uint8_t new_state, uint8_t disp_trans);
+void mode_message(PGM_P pstr);
 void mode_zone_display(void);
 void mode_time_display_tick(void);
+void mode_time_display_draw(uint8_t redraw);
 void mode_time_display_semitick(void);
 void mode_settime_display(uint8_t hour, uint8_t minute, uint8_t second);
 void mode_alarm_display(uint8_t hour, uint8_t minute);
@@ -57,8 +72,20 @@ void mode_wake(void) {
 
 // called each second; updates current mode as required
 void mode_tick(void) {
+    uint8_t drawn;
+
     switch(mode.state) {
 	case MODE_TIME_DISPLAY:
+	    // time remains drawn only if no message replaces it below
+	    drawn = mode.status & MODE_TIME_DRAWN;
+	    mode.status &= ~MODE_TIME_DRAWN;
+
+#ifdef DISPLAY_MARQUEE
+	    // marquee owns the display until its text scrolls off;
+	    // the time is then redrawn in full
+	    if(display_marquee_active()) break;
+#endif  // DISPLAY_MARQUEE
+
 	    // update time display for each tick of the clock
 	    if(time.status & TIME_UNSET && time.second & 0x01) {
 		if(system.initial_mcusr & _BV(WDRF)) {
@@ -73,22 +100,19 @@ void mode_tick(void) {
 		    display_pstr(0, PSTR("oth rset"));
 		}
 		display_transition(DISPLAY_TRANS_INSTANT);
-	    } else if(system.status & SYSTEM_LOW_BATTERY
-		    && time.second & 0x01) {
-		display_pstr(0, PSTR("bad batt"));
-		display_transition(DISPLAY_TRANS_INSTANT);
+	    } else if(HOTFLAG_TEST(SYSTEM_LOW_BATTERY) && MODE_MESSAGE_DUE) {
+		mode_message(MODE_MESSAGE("bad batt", "backup battery low"));
 #if defined(GPS_TIMEKEEPING) && defined(GPS_LOST_ERROR_MSG)
-	    } else if(gps.data_timer && !gps.warn_timer
-		    && time.second & 0x01) {
-		display_pstr(0, PSTR("gps lost"));
-		display_transition(DISPLAY_TRANS_INSTANT);
+	    } else if(timer_active(TIMER_GPS_DATA)
+		    && !timer_active(TIMER_GPS_WARN) && MODE_MESSAGE_DUE) {
+		mode_message(MODE_MESSAGE("gps lost", "gps signal lost"));
 #endif  // GPS_TIMEKEEPING && GPS_LOST_ERROR_MSG
 #ifdef TEMPERATURE_SENSOR
 	    } else if(system.sleep_wake_timer > 2
 		    && temp.status & TEMP_CONV_INVALID
-		    && time.second & 0x01) {
-		display_pstr(0, PSTR("temp err"));
-		display_transition(DISPLAY_TRANS_INSTANT);
+		    && MODE_MESSAGE_DUE) {
+		mode_message(MODE_MESSAGE("temp err",
+					  "temperature sensor error"));
 #endif  // TEMPERATURE_SENSOR
 	    } else {
 		if(time.scroll_delay && time.second % time.scroll_delay == 1) {
@@ -100,16 +124,21 @@ void mode_tick(void) {
 		    } else {
 			mode_update(MODE_MONTHDAY_DISPLAY, DISPLAY_TRANS_LEFT);
 		    }
+		} else if(drawn) {
+		    // redraw changed digits; transition only if
+		    // something visible changed
+		    mode_time_display_draw(FALSE);
+		    if(display_changed()) {
+			display_transition(DISPLAY_TRANS_INSTANT);
+		    }
 		} else {
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_INSTANT);
 		}
 	    }
 	    break;
 	case MODE_CFGREGN_TIMEFMT_FORMAT:
-	    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-		if((mode.timer & 0x00FF) < 0xFF - BLINK_OFF_SEMITICKS) {
-		    mode_time_display_tick();
-		}
+	    if((mode.timer & 0x00FF) < 0xFF - BLINK_OFF_SEMITICKS) {
+		mode_time_display_tick();
 	    }
 	    break;
     }
@@ -146,21 +175,25 @@ void mode_semitick(void) {
 		    }
 		    break;
 		default:
-		    cli();
-                   if( (time.status & TIME_UNSET
-                        || system.status & SYSTEM_LOW_BATTERY)
-                           && time.second & 0x01) {
-			sei();
-			break;
-		    }
+		    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+			// error messages replace time on odd seconds
+			uint8_t error = time.status & TIME_UNSET;
+#ifndef DISPLAY_MARQUEE
+			error = error || HOTFLAG_TEST(SYSTEM_LOW_BATTERY);
 #ifdef GPS_TIMEKEEPING
-		    if(gps.data_timer && !gps.warn_timer && time.second & 0x01){
-			sei();
-			break;
-		    }
+			error = error || (timer_active(TIMER_GPS_DATA)
+				&& !timer_active(TIMER_GPS_WARN));
 #endif  // GPS_TIMEKEEPING
-		    mode_time_display_semitick();
-		    sei();
+#endif  // ~DISPLAY_MARQUEE
+			uint8_t shown = !error || !(time.second & 0x01);
+#ifdef DISPLAY_MARQUEE
+			// other messages scroll by in place of the time
+			shown = shown && !display_marquee_active();
+#endif  // DISPLAY_MARQUEE
+			if(shown) {
+			    mode_time_display_semitick();
+			}
+		    }
 		    break;
 	    }
 	    return;  // no timout; skip code below
@@ -214,8 +247,13 @@ void mode_semitick(void) {
 	    return;  // time ourselves; skip code below
 	case MODE_ALARMSET_DISPLAY:
 	    if(btn || ++mode.timer > 1250) {
-		*mode.tmp = 0;
-		mode_update(MODE_ALARMIDX_DISPLAY, DISPLAY_TRANS_LEFT);
+		// show each enabled alarm
+		*mode.tmp = alarm_loadenabled(0);
+		if(*mode.tmp < ALARM_COUNT) {
+		    mode_update(MODE_ALARMIDX_DISPLAY, DISPLAY_TRANS_LEFT);
+		} else {
+		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
+		}
 	    }
 	    return;  // time ourselves; skip code below
 	case MODE_ALARMIDX_DISPLAY:
@@ -225,18 +263,13 @@ void mode_semitick(void) {
 	    return;  // time ourselves; skip code below
 	case MODE_ALARMTIME_DISPLAY:
 	    if(btn || ++mode.timer > 1250) {
-		if(alarm.days[*mode.tmp] & ALARM_ENABLED) {
-		    mode_update(MODE_ALARMDAYS_DISPLAY, DISPLAY_TRANS_LEFT);
-		} else if(++(*mode.tmp) < ALARM_COUNT) {
-		    mode_update(MODE_ALARMIDX_DISPLAY, DISPLAY_TRANS_LEFT);
-		} else {
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		}
+		mode_update(MODE_ALARMDAYS_DISPLAY, DISPLAY_TRANS_LEFT);
 	    }
 	    return;  // time ourselves; skip code below
 	case MODE_ALARMDAYS_DISPLAY:
 	    if(btn || ++mode.timer > 1250) {
-		if(++(*mode.tmp) < ALARM_COUNT) {
+		*mode.tmp = alarm_loadenabled(*mode.tmp + 1);
+		if(*mode.tmp < ALARM_COUNT) {
 		    mode_update(MODE_ALARMIDX_DISPLAY, DISPLAY_TRANS_LEFT);
 		} else {
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
@@ -277,6 +310,7 @@ void mode_semitick(void) {
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
 		    break;
 		case BUTTONS_SET:
+		    alarm_loadalarm(*mode.tmp);
 		    mode_update(MODE_SETALARM_ENABLE, DISPLAY_TRANS_UP);
 		    break;
 #ifdef ADAFRUIT_BUTTONS
@@ -288,9 +322,20 @@ void mode_semitick(void) {
 #else
 		case BUTTONS_PLUS:
 #endif
-		    ++(*mode.tmp);
-		    *mode.tmp %= ALARM_COUNT;
-		    mode_update(MODE_SETALARM_IDX, DISPLAY_TRANS_LEFT);
+		    if(buttons.state & BUTTONS_REPEATING) {
+			// holding the button pages through the alarms
+			*mode.tmp += MODE_ALARM_PAGE;
+#ifdef ADAFRUIT_BUTTONS
+			// stop at last alarm; next step leaves the menu
+			if(*mode.tmp >= ALARM_COUNT) *mode.tmp = ALARM_COUNT - 1;
+#endif  // ADAFRUIT_BUTTONS
+			*mode.tmp %= ALARM_COUNT;
+			mode_update(MODE_SETALARM_IDX, DISPLAY_TRANS_INSTANT);
+		    } else {
+			++(*mode.tmp);
+			*mode.tmp %= ALARM_COUNT;
+			mode_update(MODE_SETALARM_IDX, DISPLAY_TRANS_LEFT);
+		    }
 		    break;
 		default:
 		    break;
@@ -303,7 +348,7 @@ void mode_semitick(void) {
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
 		    break;
 		case BUTTONS_SET:
-		    if(alarm.days[*mode.tmp] & ALARM_ENABLED) {
+		    if(alarm.days & ALARM_ENABLED) {
 			mode_update(MODE_SETALARM_HOUR, DISPLAY_TRANS_UP);
 		    } else {
 			alarm_savealarm(*mode.tmp);
@@ -311,10 +356,10 @@ void mode_semitick(void) {
 		    }
 		    break;
 		case BUTTONS_PLUS:
-		    if(alarm.days[*mode.tmp] & ALARM_ENABLED) {
-			alarm.days[*mode.tmp] &= ~ALARM_ENABLED;
+		    if(alarm.days & ALARM_ENABLED) {
+			alarm.days &= ~ALARM_ENABLED;
 		    } else {
-			alarm.days[*mode.tmp] |= ALARM_ENABLED;
+			alarm.days |= ALARM_ENABLED;
 		    }
 		    mode_update(MODE_SETALARM_ENABLE, DISPLAY_TRANS_INSTANT);
 		    break;
@@ -335,8 +380,8 @@ void mode_semitick(void) {
 		    mode_update(MODE_SETALARM_MINUTE, DISPLAY_TRANS_INSTANT);
 		    break;
 		case BUTTONS_PLUS:
-		    ++alarm.hours[*mode.tmp];
-		    alarm.hours[*mode.tmp] %= 24;
+		    ++alarm.hour;
+		    alarm.hour %= 24;
 		    mode_update(MODE_SETALARM_HOUR, DISPLAY_TRANS_INSTANT);
 		    break;
 		default:
@@ -353,16 +398,16 @@ void mode_semitick(void) {
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
 		    break;
 		case BUTTONS_SET:
-		    if(alarm.days[*mode.tmp] == ALARM_ENABLED) {
+		    if(alarm.days == ALARM_ENABLED) {
 			mode.tmp[MODE_TMP_DAYS] = TIME_ALLDAYS | ALARM_ENABLED;
 		    } else {
-			mode.tmp[MODE_TMP_DAYS] = alarm.days[*mode.tmp];
+			mode.tmp[MODE_TMP_DAYS] = alarm.days;
 		    }
 		    mode_update(MODE_SETALARM_DAYS_OPTIONS, DISPLAY_TRANS_UP);
 		    break;
 		case BUTTONS_PLUS:
-		    ++alarm.minutes[*mode.tmp];
-		    alarm.minutes[*mode.tmp] %= 60;
+		    ++alarm.minute;
+		    alarm.minute %= 60;
 		    mode_update(MODE_SETALARM_MINUTE, DISPLAY_TRANS_INSTANT);
 		    break;
 		default:
@@ -383,7 +428,7 @@ void mode_semitick(void) {
 			case TIME_ALLDAYS | ALARM_ENABLED:
 			case TIME_WEEKDAYS | ALARM_ENABLED:
 			case TIME_WEEKENDS | ALARM_ENABLED:
-			    alarm.days[*mode.tmp] = mode.tmp[MODE_TMP_DAYS];
+			    alarm.days = mode.tmp[MODE_TMP_DAYS];
 			    alarm_savealarm(*mode.tmp);
 			    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
 			    break;
@@ -395,7 +440,7 @@ void mode_semitick(void) {
 				        DISPLAY_TRANS_UP);
 			    break;
 			default:
-			    mode.tmp[MODE_TMP_DAYS] = alarm.days[*mode.tmp];
+			    mode.tmp[MODE_TMP_DAYS] = alarm.days;
 			    mode.tmp[MODE_TMP_IDX] = 0;
 			    mode_update(MODE_SETALARM_DAYS_CUSTOM,
 				        DISPLAY_TRANS_UP);
@@ -442,7 +487,7 @@ void mode_semitick(void) {
 			mode_update(MODE_SETALARM_DAYS_CUSTOM,
 				    DISPLAY_TRANS_INSTANT);
 		    } else {
-			alarm.days[*mode.tmp] = mode.tmp[MODE_TMP_DAYS];
+			alarm.days = mode.tmp[MODE_TMP_DAYS];
 			alarm_savealarm(*mode.tmp);
 			mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
 		    }
@@ -823,9 +868,9 @@ void mode_semitick(void) {
 		            & (ALARM_SOUNDING_PULSE | ALARM_SNOOZING_PULSE);
 
 		if(*mode.tmp) {
-		    display.status |=  DISPLAY_PULSING;
+		    HOTFLAG_SET(DISPLAY_PULSING);
 		} else {
-		    display.status &= ~DISPLAY_PULSING;
+		    HOTFLAG_CLEAR(DISPLAY_PULSING);
 		    display_autodim();
 		}
 	    };
@@ -844,12 +889,12 @@ void mode_semitick(void) {
 	case MODE_CFGALARM_SETHEARTBEAT_TOGGLE:
 	    switch(btn) {
 		case BUTTONS_MENU:
-		    display.status &= ~DISPLAY_PULSING;
+		    HOTFLAG_CLEAR(DISPLAY_PULSING);
 		    display_autodim();
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
 		    break;
 		case BUTTONS_SET:
-		    display.status &= ~DISPLAY_PULSING;
+		    HOTFLAG_CLEAR(DISPLAY_PULSING);
 		    display_autodim();
 		    alarm.status &= (  ~ALARM_SOUNDING_PULSE
 			             & ~ALARM_SNOOZING_PULSE);
@@ -874,9 +919,9 @@ void mode_semitick(void) {
 			    break;
 		    }
 		    if(*mode.tmp) {
-			display.status |=  DISPLAY_PULSING;
+			HOTFLAG_SET(DISPLAY_PULSING);
 		    } else {
-			display.status &= ~DISPLAY_PULSING;
+			HOTFLAG_CLEAR(DISPLAY_PULSING);
 			display_autodim();
 		    }
 		    mode_update(MODE_CFGALARM_SETHEARTBEAT_TOGGLE,
@@ -884,7 +929,7 @@ void mode_semitick(void) {
 		    break;
 		default:
 		    if(mode.timer == MODE_TIMEOUT) {
-			display.status &= ~DISPLAY_PULSING;
+			HOTFLAG_CLEAR(DISPLAY_PULSING);
 			display_autodim();
 		    }
 		    break;
@@ -2180,11 +2225,31 @@ void mode_snoozing(void) {
 }
 
 
+// show a status message (see MODE_MESSAGE()) in place of the time:
+// a brief message fills the display for one second, while with
+// DISPLAY_MARQUEE the full message scrolls by and the time display
+// waits for it
+void mode_message(PGM_P pstr) {
+#ifdef DISPLAY_MARQUEE
+    display_marquee_pstr(pstr);
+#else
+    display_pstr(0, pstr);
+    display_transition(DISPLAY_TRANS_INSTANT);
+#endif  // DISPLAY_MARQUEE
+}
+
+
 // change mode to specified state and update display
 void mode_update(uint8_t new_state, uint8_t disp_trans) {
     PGM_P pstr_ptr;
 
+#ifdef DISPLAY_MARQUEE
+    // the new mode takes over the display
+    display_marquee_stop();
+#endif  // DISPLAY_MARQUEE
+
     mode.status |= MODE_DISPLAY_PRETRANSITION;
+    mode.status &= ~MODE_TIME_DRAWN;
     mode.timer = 0;
     mode.state = new_state;
 
@@ -2215,15 +2280,14 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    display_twodigit_leftadj(7, *mode.tmp + 1);
 	    break;
 	case MODE_ALARMTIME_DISPLAY:
-	    if(alarm.days[*mode.tmp] & ALARM_ENABLED) {
-		mode_alarm_display(alarm.hours[*mode.tmp],
-				   alarm.minutes[*mode.tmp]);
+	    if(alarm.days & ALARM_ENABLED) {
+		mode_alarm_display(alarm.hour, alarm.minute);
 	    } else {
 		display_pstr(0, PSTR("disabled"));
 	    }
 	    break;
 	case MODE_ALARMDAYS_DISPLAY:
-	    switch(alarm.days[*mode.tmp] & ~ALARM_ENABLED) {
+	    switch(alarm.days & ~ALARM_ENABLED) {
 		case TIME_ALLDAYS:
 		    display_pstr(0, PSTR("all days"));
 		    break;
@@ -2234,7 +2298,7 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 		    display_pstr(0, PSTR("weekends"));
 		    break;
 		default:
-		    mode_daysofweek_display(alarm.days[*mode.tmp]);
+		    mode_daysofweek_display(alarm.days);
 		    break;
 	    }
 	    break;
@@ -2252,7 +2316,7 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    display_twodigit_leftadj(7, *mode.tmp + 1);
 	    break;
 	case MODE_SETALARM_ENABLE:
-	    if(alarm.days[*mode.tmp] & ALARM_ENABLED) {
+	    if(alarm.days & ALARM_ENABLED) {
 		pstr_ptr = PSTR("on");
 	    } else {
 		pstr_ptr = PSTR("off");
@@ -2260,8 +2324,7 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    mode_texttext_display(PSTR("alar"), pstr_ptr);
 	    break;
 	case MODE_SETALARM_HOUR:
-	    mode_alarm_display(alarm.hours[*mode.tmp],
-			       alarm.minutes[*mode.tmp]);
+	    mode_alarm_display(alarm.hour, alarm.minute);
 	    if(time.timeformat_flags & TIME_TIMEFORMAT_12HOUR) {
 		display_dotselect(1, 2);
 	    } else {
@@ -2269,8 +2332,7 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    }
 	    break;
 	case MODE_SETALARM_MINUTE:
-	    mode_alarm_display(alarm.hours[*mode.tmp],
-			       alarm.minutes[*mode.tmp]);
+	    mode_alarm_display(alarm.hour, alarm.minute);
 	    if(time.timeformat_flags & TIME_TIMEFORMAT_12HOUR) {
 		display_dotselect(4, 5);
 	    } else {
@@ -2724,72 +2786,112 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 
 // updates the time display every second
 void mode_time_display_tick(void) {
-    uint8_t hour_to_display = time.hour;
-    uint8_t hour_idx = 1;
+    mode_time_display_draw(TRUE);
+}
 
-    display_clearall();
 
-    if(time.timeformat_idx == TIME_TIMEFORMAT_HH_MM) {
-	hour_idx = 2;
+#ifdef TIME_BCD
+// draw snapshot field from packed-bcd copy, without division
+#define MODE_TWODIGIT(idx, field) \
+    display_twodigit_bcd_zeropad(idx, now.bcd_ ## field)
+#else
+#define MODE_TWODIGIT(idx, field) \
+    display_twodigit_zeropad(idx, now.field)
+#endif  // TIME_BCD
+
+// draws the current time in display_prebuf(); if the time is still
+// drawn from the last call and redraw is false, hours and minutes
+// are only drawn again when changed (separators, seconds, and
+// indicators are cheap and drawn every time, in the same order)
+void mode_time_display_draw(uint8_t redraw) {
+    time_snap_t now;
+    time_snapshot(&now);
+
+    uint8_t hour_to_display = now.hour;
+    uint8_t hour_idx = 1;
+
+    // hour change also changes am/pm characters
+    if(!(mode.status & MODE_TIME_DRAWN) || now.hour != mode.drawn_hour) {
+	redraw = TRUE;
     }
 
-    if(time.timeformat_flags & TIME_TIMEFORMAT_12HOUR) {
-	if(hour_to_display > 12) hour_to_display -= 12;
-	if(hour_to_display == 0) hour_to_display  = 12;
-	display_twodigit_rightadj(hour_idx, hour_to_display);
-    } else {
-	display_twodigit_zeropad(hour_idx, hour_to_display);
+    uint8_t minute = redraw || now.minute != mode.drawn_minute;
+
+    if(redraw) {
+	display_clearall();
+
+	if(time.timeformat_idx == TIME_TIMEFORMAT_HH_MM) {
+	    hour_idx = 2;
+	}
+
+	if(time.timeformat_flags & TIME_TIMEFORMAT_12HOUR) {
+	    if(hour_to_display > 12) hour_to_display -= 12;
+	    if(hour_to_display == 0) hour_to_display  = 12;
+#ifdef TIME_BCD
+	    // hours 10 to 12 become 0x10 to 0x12
+	    if(hour_to_display >= 10) hour_to_display += 0x10 - 10;
+	    display_twodigit_bcd_rightadj(hour_idx, hour_to_display);
+#else
+	    display_twodigit_rightadj(hour_idx, hour_to_display);
+#endif  // TIME_BCD
+	} else {
+	    MODE_TWODIGIT(hour_idx, hour);
+	}
     }
 
     switch(time.timeformat_idx) {
 	case TIME_TIMEFORMAT_HH_MM_SS:
 	    display_char(3, ':');
-	    display_twodigit_zeropad(4, time.minute);
+	    if(minute) MODE_TWODIGIT(4, minute);
 	    display_char(6, ':');
-	    display_twodigit_zeropad(7, time.second);
+	    MODE_TWODIGIT(7, second);
 	    break;
 	case TIME_TIMEFORMAT_HH_MM_dial:
 	    display_char(3, ':');
-	    display_twodigit_zeropad(4, time.minute);
-	    display_dial(7, time.second);
+	    if(minute) MODE_TWODIGIT(4, minute);
+	    display_dial(7, now.second);
 	    break;
 	case TIME_TIMEFORMAT_HHMMSS_split:
 	    display_dotsep(2, TRUE);
-	    display_twodigit_zeropad(3, time.minute);
+	    if(minute) MODE_TWODIGIT(3, minute);
 	    display_dotsep(4, TRUE);
-	    display_twodigit_zeropad(5, time.second);
+	    MODE_TWODIGIT(5, second);
 	    display_dotsep(6, TRUE);
-	    display_twodigit_zeropad(7, 0);
+	    if(redraw) display_twodigit_zeropad(7, 0);
 	    break;
 	case TIME_TIMEFORMAT_HH_MM:
 	    display_char(4, ':');
-	    display_twodigit_zeropad(5, time.minute);
+	    if(minute) MODE_TWODIGIT(5, minute);
 	    break;
 	case TIME_TIMEFORMAT_HH_MM_PM:
 	    display_char(8, 'm');
 	case TIME_TIMEFORMAT_HH_MM_P:
 	    display_char(3, ':');
-	    display_twodigit_zeropad(4, time.minute);
-	    display_char(7, (time.hour < 12 ? 'a' : 'p'));
+	    if(minute) MODE_TWODIGIT(4, minute);
+	    display_char(7, (now.hour < 12 ? 'a' : 'p'));
 	    break;
 	case TIME_TIMEFORMAT_HHMMSSPM:
 	    display_char(8, 'm');
 	case TIME_TIMEFORMAT_HHMMSSP:
 	    display_dotsep(2, TRUE);
-	    display_twodigit_zeropad(3, time.minute);
+	    if(minute) MODE_TWODIGIT(3, minute);
 	    display_dotsep(4, TRUE);
-	    display_twodigit_zeropad(5, time.second);
+	    MODE_TWODIGIT(5, second);
 	    display_dotsep(6, TRUE);
-	    display_char(7, (time.hour < 12 ? 'a' : 'p'));
+	    display_char(7, (now.hour < 12 ? 'a' : 'p'));
 	    break;
 	default:
 	    break;
     }
 
+    mode.drawn_hour   = now.hour;
+    mode.drawn_minute = now.minute;
+    mode.status |= MODE_TIME_DRAWN;
+
     // set or clear am or pm indicator
     if(time.timeformat_flags & TIME_TIMEFORMAT_SHOWAMPM) {
 	// show leftmost circle if pm
-	display_dot(0, time.hour >= 12);
+	display_dot(0, now.hour >= 12);
 	if(time.timeformat_flags & TIME_TIMEFORMAT_SHOWDST) {
 	    // show rightmost decimal if dst
 	    display_dot(8, time.status & TIME_DST);
@@ -2819,7 +2921,7 @@ void mode_time_display_tick(void) {
     // show alarm status with leftmost dash
     display_dash(0, alarm.status & ALARM_SET
 		    && ( !(alarm.status & (ALARM_SOUNDING | ALARM_SNOOZE))
-		    || time.second & 0x01 || display.status & DISPLAY_PULSING));
+		    || now.second & 0x01 || HOTFLAG_TEST(DISPLAY_PULSING)));
 
     display_updatecolons();
     mode_time_display_semitick();
@@ -2829,7 +2931,9 @@ void mode_time_display_tick(void) {
 // updates the time display every semitick
 void mode_time_display_semitick(void) {
     if(time.timeformat_idx == TIME_TIMEFORMAT_HHMMSS_split) {
-	display_twodigit_zeropad(7, (((uint16_t)100 * TCNT2) >> 7));
+	time_frac_t now;
+	time_now_frac(&now);
+	display_twodigit_zeropad(7, (((uint16_t)100 * now.frac) >> 7));
 
 	if(time.timeformat_flags & TIME_TIMEFORMAT_SHOWAMPM) {
 	    if(time.timeformat_flags & TIME_TIMEFORMAT_SHOWDST) {
@@ -2852,8 +2956,11 @@ void mode_time_display_semitick(void) {
 	// update display manually to save microcontroller cycles
 	if(!(mode.status & MODE_DISPLAY_PRETRANSITION
 		    || display.trans_type != DISPLAY_TRANS_NONE)) {
-	    display.postbuf[8] = display.prebuf[8];
-	    display.postbuf[7] = display.prebuf[7];
+	    display_frame_t* prebuf  = display_prebuf();
+	    display_frame_t* postbuf = display_postbuf();
+
+	    postbuf->segs[8] = prebuf->segs[8];
+	    postbuf->segs[7] = prebuf->segs[7];
 	}
     }
 }
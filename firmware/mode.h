@@ -9,6 +9,10 @@
 // default menu timeout; on timeout, mode changes to time display
 #define MODE_TIMEOUT 30000  // semiticks (~milliseconds)
 
+// alarms skipped with each repeat while the button which steps
+// through alarm numbers is held
+#define MODE_ALARM_PAGE 10
+
 // various clock modes; current mode given by mode.state
 enum {
     MODE_TIME_DISPLAY,
@@ -113,6 +117,16 @@ enum {
 // over the transition (e.g. after display_transition() is called)
 #define MODE_DISPLAY_PRETRANSITION 0x01
 
+// status flag set while display_prebuf() holds the time drawn by
+// mode_time_display_draw(), so the next second need only redraw
+// the digits which changed
+#define MODE_TIME_DRAWN 0x02
+
+#ifdef DISPLAY_MARQUEE
+// status messages scroll by once every this many seconds
+#define MODE_MARQUEE_INTERVAL 30  // seconds
+#endif  // DISPLAY_MARQUEE
+
 
 #define MODE_TMP_YEAR  0
 #define MODE_TMP_MONTH 1
@@ -135,6 +149,8 @@ typedef struct {
     uint8_t  state;  // name of current state
     uint16_t timer;  // time in current state (semiseconds)
     int8_t  tmp[3];  // place to store temporary data
+    uint8_t  drawn_hour;    // hour drawn in prebuf (MODE_TIME_DRAWN)
+    uint8_t  drawn_minute;  // minute drawn in prebuf (MODE_TIME_DRAWN)
 } mode_t;
 
 
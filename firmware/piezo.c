@@ -12,6 +12,7 @@
 #include <util/atomic.h>  // for noninterruptable blocks
 
 #include "piezo.h"
+#include "profile.h"  // for profiling atomic blocks
 #include "system.h" // alarm behavior depends on power source
 #include "usart.h"  // for debugging macros
 #include "time.h"   // for determining the date
@@ -278,7 +279,7 @@ void piezo_nextsound(void) {
 // (interpolation between vol and vol+1 using interp)
 void piezo_setvolume(uint8_t vol, uint8_t interp) {
     // if sleeping, compensate for reduced voltage by increasing volume
-    if((system.status & SYSTEM_SLEEP) && vol < 10) ++vol;
+    if(HOTFLAG_TEST(SYSTEM_SLEEP) && vol < 10) ++vol;
 
     piezo.cm_max = pgm_read_byte(&(piezo_vol2cm[vol]));
 
@@ -337,7 +338,7 @@ void piezo_sleep(void) {
 void piezo_tick(void) {
     switch(piezo.status & PIEZO_STATE_MASK) {
 	case PIEZO_ALARM_MUSIC:
-	    if(!(system.status & SYSTEM_SLEEP)) break;
+	    if(!HOTFLAG_TEST(SYSTEM_SLEEP)) break;
 	case PIEZO_ALARM_BEEPS:
 	    if(++piezo.timer & 0x0001) {
 		switch(piezo.status & PIEZO_SOUND_MASK) {
@@ -349,10 +350,10 @@ void piezo_tick(void) {
 			piezo_buzzeron(BEEP_HIGH(0));
 			break;
 		}
-		system.status |= SYSTEM_ALARM_SOUNDING;
+		HOTFLAG_SET(SYSTEM_ALARM_SOUNDING);
 	    } else {
 		piezo_buzzeroff();
-		system.status &= ~SYSTEM_ALARM_SOUNDING;
+		HOTFLAG_CLEAR(SYSTEM_ALARM_SOUNDING);
 	    }
 	    break;
 
@@ -491,7 +492,7 @@ void piezo_buzzeron(uint16_t sound) {
     // reduce compare_match to control volume, when possible
     if(compare_match > piezo.cm_max) compare_match = piezo.cm_max;
 
-    if(system.status & SYSTEM_SLEEP) {
+    if(HOTFLAG_TEST(SYSTEM_SLEEP)) {
 	// compensate frequency for 4x slower clock
 	top_value     >>= 2;
 	compare_match >>= 2;
@@ -699,7 +700,7 @@ void piezo_stop(void) {
     piezo_buzzeroff();
     piezo.status  &= ~PIEZO_STATE_MASK;
     piezo.status  |=  PIEZO_INACTIVE;
-    system.status &= ~SYSTEM_ALARM_SOUNDING;
+    HOTFLAG_CLEAR(SYSTEM_ALARM_SOUNDING);
 }
 
 
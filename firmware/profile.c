@@ -0,0 +1,183 @@
+// profile.c  --  measures how long atomic blocks mask interrupts
+//
+// When CRITICAL_PROFILE is defined, profile.h replaces ATOMIC_BLOCK
+// so that every block records its entry count and the longest time
+// interrupts were masked.  The table is printed over usart every
+// PROFILE_DUMP_INTERVAL seconds as lines of
+//
+//    file:line count max-cycles
+//
+// Timer0 counts system clock cycles, so times below 256 cycles are
+// exact.  Longer times are measured with timer2 (1/128 seconds per
+// count) and are lower bounds.
+//
+
+
+#include "config.h"
+#ifdef CRITICAL_PROFILE
+
+#include <avr/io.h>         // for using avr register names
+#include <avr/interrupt.h>  // for enabling and disabling interrupts
+#include <avr/pgmspace.h>   // for reading site names
+
+#include "profile.h"
+#include "system.h"  // for usart state and semitick latency
+#include "display.h" // for boost load
+#include "timer.h"   // for periodic table dumps
+#include "usart.h"   // for printing table
+
+
+// extern'ed profile table
+volatile profile_site_t profile[PROFILE_SITES];
+
+// entries into blocks without a table entry (saturates)
+volatile uint16_t profile_missed;
+
+
+// start periodic table dumps; timer_init() must be called first
+void profile_init(void) {
+    timer_start(TIMER_PROFILE, PROFILE_DUMP_INTERVAL,
+		PROFILE_DUMP_INTERVAL, profile_dump);
+}
+
+
+// returns table index for the block at file and line, adding an
+// entry if needed; called before the block masks interrupts, so
+// interrupts are only masked to claim a new entry
+uint8_t profile_site(PGM_P file, uint16_t line) {
+    uint8_t i = 0;
+
+    while(i < PROFILE_SITES) {
+	if(profile[i].file == file && profile[i].line == line) return i;
+
+	if(!profile[i].file) {
+	    uint8_t claimed = 0;
+
+	    uint8_t sreg = SREG;
+	    cli();
+	    if(!profile[i].file) {
+		profile[i].line = line;
+		profile[i].file = file;
+		claimed = 1;
+	    }
+	    SREG = sreg;
+
+	    // an interrupt may have claimed this entry first
+	    if(claimed) return i;
+	    continue;
+	}
+
+	++i;
+    }
+
+    // table full: count the entry so the dump shows sites are missing
+    uint8_t sreg = SREG;
+    cli();
+    if(profile_missed != UINT16_MAX) ++profile_missed;
+    SREG = sreg;
+
+    return PROFILE_NONE;
+}
+
+
+// sample timers on block entry; called right after cli()
+uint8_t profile_start(uint8_t site) {
+    if(site != PROFILE_NONE) {
+	profile[site].tcnt0 = TCNT0;
+	profile[site].tcnt2 = TCNT2;
+	profile[site].tov0  = TIFR0 & _BV(TOV0);
+    }
+
+    return 1;
+}
+
+
+// sample timers on block exit and update table; called
+// right before the saved interrupt state is restored
+void profile_exit(const uint8_t* site) {
+    uint8_t tcnt0 = TCNT0;
+    uint8_t tcnt2 = TCNT2;
+    uint8_t tov0  = TIFR0 & _BV(TOV0);
+
+    if(*site == PROFILE_NONE) return;
+
+    volatile profile_site_t* p = &(profile[*site]);
+
+    uint32_t cycles = (uint8_t)(tcnt0 - p->tcnt0);
+
+    // timer0 wrapped if its overflow flag was raised during the
+    // block; beyond one wrap, fall back on timer2, which restarts
+    // after reaching OCR2A
+    if(tov0 && !p->tov0) {
+	cycles += 256;
+
+	int16_t ticks = tcnt2 - p->tcnt2;
+	if(ticks < 0) ticks += OCR2A + 1;
+
+	if(ticks > 1) {
+	    uint32_t coarse = (ticks - 1) * (F_CPU / 128);
+	    if(coarse > cycles) cycles = coarse;
+	}
+    }
+
+    if(p->count != UINT16_MAX) ++p->count;
+    if(cycles > p->max) p->max = cycles;
+}
+
+
+// transmit profile table over usart
+void profile_dump(void) {
+    // usart is disabled during sleep
+    if(HOTFLAG_TEST(SYSTEM_SLEEP)) return;
+
+    usart_print_pstr(PSTR("profile"));
+    usart_print_ln();
+
+    for(uint8_t i = 0; i < PROFILE_SITES && profile[i].file; ++i) {
+	uint16_t count;
+	uint32_t max;
+
+	uint8_t sreg = SREG;
+	cli();
+	count = profile[i].count;
+	max   = profile[i].max;
+	SREG = sreg;
+
+	usart_print_pstr(profile[i].file);
+	usart_putc(':');
+	usart_print_int(profile[i].line);
+	usart_putc(' ');
+	usart_print_int(count);
+	usart_putc(' ');
+	usart_print_int(max);
+	usart_print_ln();
+    }
+
+    // entries into blocks left out of a full table
+    uint16_t missed;
+
+    uint8_t sreg = SREG;
+    cli();
+    missed = profile_missed;
+    SREG = sreg;
+
+    usart_print_pstr(PSTR("missed "));
+    usart_print_int(missed);
+    usart_print_ln();
+
+    // worst-case semitick dispatch latency (timer0 overflows)
+    usart_print_pstr(PSTR("semitick delay "));
+    usart_print_int(system.semitick_delay);
+    usart_print_ln();
+
+#ifdef BOOST_LOAD_TRIM
+    // boost load for tuning the trim
+    usart_print_pstr(PSTR("lit segments "));
+    usart_print_int(display.lit_segments);
+    usart_print_pstr(PSTR(" ocr0a "));
+    usart_print_int(OCR0A);
+    usart_print_ln();
+#endif  // BOOST_LOAD_TRIM
+}
+
+#endif  // CRITICAL_PROFILE
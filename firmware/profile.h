@@ -0,0 +1,72 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>        // for using standard integer types
+#include <avr/pgmspace.h>  // for storing site names in program memory
+#include <util/atomic.h>   // for the atomic blocks redefined below
+
+#include "config.h"  // for configuration macros
+
+
+#ifdef CRITICAL_PROFILE
+
+#ifndef DEBUG
+#error CRITICAL_PROFILE requires DEBUG for serial output
+#endif  // ~DEBUG
+
+// maximum number of distinct atomic blocks profiled; blocks
+// first entered after the table fills are not profiled, but are
+// counted in profile_missed and reported with each dump
+#ifndef PROFILE_SITES
+#define PROFILE_SITES 32
+#endif  // ~PROFILE_SITES
+
+// seconds between table dumps over usart
+#define PROFILE_DUMP_INTERVAL 60
+
+// marks a block without a table entry
+#define PROFILE_NONE 0xFF
+
+
+typedef struct {
+    PGM_P    file;    // source file containing block
+    uint16_t line;    // line number of block
+    uint16_t count;   // times block was entered (saturates)
+    uint32_t max;     // longest time interrupts were masked (cycles)
+
+    uint8_t  tcnt0;   // TCNT0 when block was last entered
+    uint8_t  tcnt2;   // TCNT2 when block was last entered
+    uint8_t  tov0;    // TOV0 flag when block was last entered
+} profile_site_t;
+
+
+extern volatile profile_site_t profile[PROFILE_SITES];
+extern volatile uint16_t profile_missed;
+
+
+void profile_init(void);
+
+uint8_t profile_site(PGM_P file, uint16_t line);
+uint8_t profile_start(uint8_t site);
+void profile_exit(const uint8_t* site);
+
+void profile_dump(void);
+
+
+// replaces ATOMIC_BLOCK from <util/atomic.h>: the block's site is
+// found before interrupts are masked, timer counts are sampled right
+// after cli and again (through the cleanup attribute) right before
+// the saved interrupt state is restored
+#undef ATOMIC_BLOCK
+#define ATOMIC_BLOCK(type) \
+    for(type, __prof_site __attribute__((__cleanup__(profile_exit))) \
+		  = profile_site(PSTR(__FILE__), __LINE__), \
+	      __ToDo = (__iCliRetVal(), profile_start(__prof_site)); \
+	__ToDo; __ToDo = 0)
+
+#else  // CRITICAL_PROFILE
+
+static inline void profile_init(void) {};
+
+#endif  // CRITICAL_PROFILE
+#endif  // PROFILE_H
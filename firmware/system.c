@@ -24,8 +24,16 @@
 
 
 #include "system.h"
-#include "usart.h"  // for debugging output
-#include "mode.h"   // to refresh time when clearing low battery warning
+#include "usart.h"    // for debugging output
+#include "mode.h"     // to refresh time when clearing low battery warning
+#include "timer.h"    // for dispatching tick and semitick functions
+#include "time.h"
+#include "buttons.h"
+#include "alarm.h"
+#include "piezo.h"
+#include "display.h"
+#include "gps.h"
+#include "temp.h"
 
 
 // extern'ed system status data
@@ -42,7 +50,9 @@ void system_init(void) {
     MCUSR = 0;  // clear any watchdog timer flags
     wdt_enable(WDTO_8S);  // enable eight-second watchdog timer
 
-    system.status &= ~SYSTEM_SLEEP;
+    HOTFLAG_CLEAR(SYSTEM_SLEEP);
+
+    SYSTEM_SEMICOUNTER = SYSTEM_SEMITICK_OVERFLOWS;
 
     // enable pull-up resistors on unused pins to ensure a defined value
 #if !defined(VFD_TO_SPEC) || defined(XMAS_DESIGN)
@@ -71,8 +81,12 @@ void system_init(void) {
 
 
 // when clock goes to sleep, restart sleep/wake timer
+// and discard events which will not be dispatched
 void system_sleep(void) {
     system.sleep_wake_timer = 0;
+    system.ticks     = 0;
+    system.semiticks = 0;
+    system.semitick_age = 0;
 }
 
 
@@ -82,14 +96,72 @@ void system_wake(void) {
 }
 
 
-// repeatedly enter idle mode forevermore
+// dispatch events raised by interrupts or enter idle mode forevermore;
+// each tick or semitick runs to completion with interrupts enabled,
+// and pending semiticks run first since they have shorter deadlines
 void system_idle_loop(void) {
+    uint8_t semitick_successful = 1;  // set to 1 every ~1 millisecond
+
     sleep_enable();
     for(;;) {
 	cli();
-	set_sleep_mode(SLEEP_MODE_IDLE);
-	sei();
-	sleep_cpu();
+	if(system.semiticks) {
+	    // record worst-case delay between semitick and dispatch
+	    if(system.semitick_age > system.semitick_delay) {
+		system.semitick_delay = system.semitick_age;
+	    }
+
+	    // next pending semitick (if any) was raised 32 overflows later
+	    --system.semiticks;
+	    if(system.semiticks && system.semitick_age > 32) {
+		system.semitick_age -= 32;
+	    } else {
+		system.semitick_age  = 0;
+	    }
+	    sei();
+
+	    // code below runs every "semisecond" or
+	    // every 1.02 milliseconds (0.98 khz)
+	    system_semitick();
+	    time_semitick();
+	    buttons_semitick();
+	    alarm_semitick();
+	    piezo_semitick();
+	    mode_semitick();
+	    display_semitick();
+	    gps_semitick();
+	    usart_semitick();
+	    temp_semitick();
+
+	    semitick_successful = 1;
+	} else if(system.ticks) {
+	    // ticks are counted, so each pending tick is dispatched
+	    // even if the loop stalls for more than a second
+	    --system.ticks;
+	    sei();
+
+	    // watchdog resets unless semiticks are being dispatched
+	    if(semitick_successful) wdt_reset();
+	    semitick_successful = 0;
+
+	    // system_tick() and time_tick() run from
+	    // TIMER2_COMPB_vect to keep the time base exact
+	    timer_tick();
+	    buttons_tick();
+	    alarm_tick();
+	    piezo_tick();
+	    mode_tick();
+	    display_tick();
+	    gps_tick();
+	    usart_tick();
+	    temp_tick();
+	} else {
+	    // sleep until next interrupt; sleep_cpu() executes
+	    // before any interrupt enabled by sei() can run
+	    set_sleep_mode(SLEEP_MODE_IDLE);
+	    sei();
+	    sleep_cpu();
+	}
     }
 }
 
@@ -109,7 +181,7 @@ void system_bod_disable_sleep(void) {
 // repeatedly enter power save mode until power restored
 void system_sleep_loop(void) {
     sleep_enable();                 // permit sleep mode
-    system.status |= SYSTEM_SLEEP;  // set sleep flag
+    HOTFLAG_SET(SYSTEM_SLEEP);      // set sleep flag
     ACSR = _BV(ACD) | _BV(ACI);     // disable analog comparator and
     				    // clear analog comparator interrupt
     do {
@@ -136,7 +208,7 @@ void system_sleep_loop(void) {
 			  | _BV(OCR2AUB) | _BV(OCR2BUB)
 			  | _BV(TCR2AUB) | _BV(TCR2BUB) ));
 
-	    if(system.status & SYSTEM_ALARM_SOUNDING) {
+	    if(HOTFLAG_TEST(SYSTEM_ALARM_SOUNDING)) {
 		// if the alarm buzzer is active, remain in idle mode
 		// so buzzer continues sounding for next second
 		set_sleep_mode(SLEEP_MODE_IDLE);
@@ -169,7 +241,7 @@ void system_sleep_loop(void) {
     // enable analog comparator interrupt
     ACSR = _BV(ACBG) | _BV(ACIE) | _BV(ACI);
 
-    system.status &= ~SYSTEM_SLEEP; // clear sleep flag
+    HOTFLAG_CLEAR(SYSTEM_SLEEP); // clear sleep flag
 }
 
 
@@ -232,17 +304,17 @@ void system_check_battery(void) {
 
     // set or clear low battery flag as required
     if(adc_curr > 1024UL * 1100 / LOW_BATTERY_VOLTAGE) {
-       system.status |= SYSTEM_LOW_BATTERY;
+       HOTFLAG_SET(SYSTEM_LOW_BATTERY);
     } else {
-       system.status &= ~_BV(SYSTEM_LOW_BATTERY);
+       HOTFLAG_CLEAR(SYSTEM_LOW_BATTERY);
     }
 }
 
 
 // return true if pressed button should clear low battery warning
 uint8_t system_onbutton(void) {
-    if(!(system.status & SYSTEM_SLEEP) && system.status & SYSTEM_LOW_BATTERY) {
-       system.status &= ~SYSTEM_LOW_BATTERY;
+    if(!HOTFLAG_TEST(SYSTEM_SLEEP) && HOTFLAG_TEST(SYSTEM_LOW_BATTERY)) {
+       HOTFLAG_CLEAR(SYSTEM_LOW_BATTERY);
        mode_tick();  // force refresh of time display
        return 1;
     }
@@ -3,6 +3,7 @@
 
 
 #include <stdint.h>  // for using standard integer types
+#include <avr/io.h>  // for using avr register names
 
 #include "config.h"  // for configuration macros
 
@@ -54,16 +55,40 @@ enum {
 };
 
 
-// flags for system.status
+// HOT FLAGS
+//
+// status flags tested in interrupts are kept in general purpose i/o
+// register GPIOR0 instead of sram, so single-flag tests and updates
+// compile to sbis/sbic/sbi/cbi.  bits are allocated as follows:
+//
+//    0x01 - 0x04    system flags below
+//    0x10 - 0x40    display flags (display.h)
+#define HOTFLAGS GPIOR0
+#define HOTFLAG_TEST(flag)  (HOTFLAGS &   (flag))
+#define HOTFLAG_SET(flag)   (HOTFLAGS |=  (flag))
+#define HOTFLAG_CLEAR(flag) (HOTFLAGS &= ~(flag))
+
+// system hot flags
 #define SYSTEM_SLEEP          0x01
 #define SYSTEM_ALARM_SOUNDING 0x02
 #define SYSTEM_LOW_BATTERY    0x04
 
+// semitick counter for the timer0 overflow interrupt; kept in a
+// general purpose i/o register for the fast path in icetube.c
+#define SYSTEM_SEMICOUNTER GPIOR1
+#define SYSTEM_SEMITICK_OVERFLOWS 32
+
+
 
 typedef struct {
-    uint8_t  status;         // system status flags
     uint8_t  initial_mcusr;  // initial value of MCUSR register
     uint32_t sleep_wake_timer;    // amount of time in sleep or wake mode
+
+    uint8_t  ticks;           // ticks awaiting dispatch
+    uint8_t  semiticks;       // semiticks awaiting dispatch
+    uint8_t  semitick_age;    // timer0 overflows since oldest semitick
+    uint8_t  semitick_delay;  // worst-case semitick dispatch latency
+			      // (in timer0 overflows, 32 us each)
 } system_t;
 
 
@@ -80,7 +105,7 @@ static inline void system_tick(void) {
     // if external power has been restored;  this must be done
     // here instead of in system_sleep_loop() because the analog
     // comparator needs a few microseconds to start
-    if(system.status & SYSTEM_SLEEP) {
+    if(HOTFLAG_TEST(SYSTEM_SLEEP)) {
        ACSR = _BV(ACBG);
     }
 
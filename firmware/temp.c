@@ -8,14 +8,17 @@
 #ifdef TEMPERATURE_SENSOR
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 #include <util/atomic.h>
 #include <avr/wdt.h>
 
 #include "temp.h"
+#include "profile.h"  // for profiling atomic blocks
 #include "time.h"
 #include "usart.h"
 #include "system.h"
+#include "timer.h"
 
 #define TEMP_CMD_SKIPROM     0xCC
 #define TEMP_CMD_CONVERTTEMP 0x44
@@ -25,35 +28,61 @@
 volatile temp_t temp;
 
 
-void temp_start_conv(void);
-void temp_read_conv(void);
-void temp_calc_error(void);
-
-uint8_t temp_reset(void);
+// time lost per second to crystal error (1 / 10^9 seconds) for each
+// degree C from TEMP_TABLE_MIN to TEMP_TABLE_MAX; the parabolic model
+// may be replaced with values measured for a particular crystal
+const uint16_t temp_xtal_error[] PROGMEM = {
+    TEMP_XTAL_ERROR(-10), TEMP_XTAL_ERROR( -9), TEMP_XTAL_ERROR( -8),
+    TEMP_XTAL_ERROR( -7), TEMP_XTAL_ERROR( -6), TEMP_XTAL_ERROR( -5),
+    TEMP_XTAL_ERROR( -4), TEMP_XTAL_ERROR( -3), TEMP_XTAL_ERROR( -2),
+    TEMP_XTAL_ERROR( -1), TEMP_XTAL_ERROR(  0), TEMP_XTAL_ERROR(  1),
+    TEMP_XTAL_ERROR(  2), TEMP_XTAL_ERROR(  3), TEMP_XTAL_ERROR(  4),
+    TEMP_XTAL_ERROR(  5), TEMP_XTAL_ERROR(  6), TEMP_XTAL_ERROR(  7),
+    TEMP_XTAL_ERROR(  8), TEMP_XTAL_ERROR(  9), TEMP_XTAL_ERROR( 10),
+    TEMP_XTAL_ERROR( 11), TEMP_XTAL_ERROR( 12), TEMP_XTAL_ERROR( 13),
+    TEMP_XTAL_ERROR( 14), TEMP_XTAL_ERROR( 15), TEMP_XTAL_ERROR( 16),
+    TEMP_XTAL_ERROR( 17), TEMP_XTAL_ERROR( 18), TEMP_XTAL_ERROR( 19),
+    TEMP_XTAL_ERROR( 20), TEMP_XTAL_ERROR( 21), TEMP_XTAL_ERROR( 22),
+    TEMP_XTAL_ERROR( 23), TEMP_XTAL_ERROR( 24), TEMP_XTAL_ERROR( 25),
+    TEMP_XTAL_ERROR( 26), TEMP_XTAL_ERROR( 27), TEMP_XTAL_ERROR( 28),
+    TEMP_XTAL_ERROR( 29), TEMP_XTAL_ERROR( 30), TEMP_XTAL_ERROR( 31),
+    TEMP_XTAL_ERROR( 32), TEMP_XTAL_ERROR( 33), TEMP_XTAL_ERROR( 34),
+    TEMP_XTAL_ERROR( 35), TEMP_XTAL_ERROR( 36), TEMP_XTAL_ERROR( 37),
+    TEMP_XTAL_ERROR( 38), TEMP_XTAL_ERROR( 39), TEMP_XTAL_ERROR( 40),
+    TEMP_XTAL_ERROR( 41), TEMP_XTAL_ERROR( 42), TEMP_XTAL_ERROR( 43),
+    TEMP_XTAL_ERROR( 44), TEMP_XTAL_ERROR( 45), TEMP_XTAL_ERROR( 46),
+    TEMP_XTAL_ERROR( 47), TEMP_XTAL_ERROR( 48), TEMP_XTAL_ERROR( 49),
+    TEMP_XTAL_ERROR( 50), TEMP_XTAL_ERROR( 51), TEMP_XTAL_ERROR( 52),
+    TEMP_XTAL_ERROR( 53), TEMP_XTAL_ERROR( 54), TEMP_XTAL_ERROR( 55),
+    TEMP_XTAL_ERROR( 56), TEMP_XTAL_ERROR( 57), TEMP_XTAL_ERROR( 58),
+    TEMP_XTAL_ERROR( 59), TEMP_XTAL_ERROR( 60),
+};
 
-void temp_write_bit(uint8_t);
-uint8_t temp_read_bit(void);
 
-void temp_write_byte(uint8_t);
-uint8_t temp_read_byte(void);
+void temp_start_conv(void);
+void temp_read_conv(void);
+uint16_t temp_xtal_error_now(void);
 
-void temp_power_bus(void);
+void temp_ow_start(uint8_t cmd, uint8_t read_count);
 
 uint8_t temp_read_scratch(void);
 
 
 // initialize timekeeping variables
 void temp_init(void) {
-    temp.status     = 0;
-    temp.int_timer  = 0;
-    temp.conv_timer = 0;
-    temp.adjust     = 0;
-    temp.error      = 0;
-    temp.temp       = TEMP_INVALID;  // invalid temperature
+    temp.status = 0;
+    temp.adjust = 0;
+    temp.error  = 0;
+    temp.temp   = TEMP_INVALID;  // invalid temperature
 }
 
 
 void temp_sleep(void) {
+    // abort any 1-Wire transaction in progress
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	temp.ow_state = TEMP_OW_IDLE;
+    }
+
     // disable output on the one-wire bus
     DDRC  &= ~_BV(PC1);  // set as input
     PORTC &= ~_BV(PC1);  // disable pull-up
@@ -65,33 +94,38 @@ void temp_sleep(void) {
 
 // query temperature probe as needed, once per second
 void temp_tick(void) {
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	++temp.int_timer;
+    // accumulate crystal error for the last second
+    temp.error += temp_xtal_error_now();
+    if(temp.error >= TEMP_ERROR_PER_ADJUST) {
+	temp.error -= TEMP_ERROR_PER_ADJUST;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	    ++temp.adjust;
+	}
     }
 
-    // sample temperature if awake
-    if(!(system.status & SYSTEM_SLEEP)) {
-
-	// prevent interruption if communication already in progress
-	cli();
-	if(temp.status & TEMP_COMM_LOCK) {
-	    sei();
-	    return;
-	} else {
-	    temp.status |= TEMP_COMM_LOCK;
-	    sei();
+    // sample temperature if awake and sensor not busy
+    if(!HOTFLAG_TEST(SYSTEM_SLEEP) && !temp.ow_state) {
+
+	// check result of previous scratchpad read
+	if(temp.status & TEMP_READ_STARTED) {
+	    if(!(temp.status & TEMP_CONV_INVALID) && !temp_read_scratch()) {
+		temp.status |= TEMP_CONV_INVALID;
+	    }
+	    temp.status &= ~TEMP_READ_STARTED;
+	    temp.status &= ~TEMP_CONV_STARTED;
+	    temp.status &= ~TEMP_CONV_INVALID;
 	}
 
-	// check previous temperature conversion as required
-	if((temp.status & TEMP_CONV_STARTED) && !--temp.conv_timer) {
-	    temp_read_conv();
-	    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-		if(!(temp.status & TEMP_CONV_INVALID)) {
-		    temp_calc_error();
-		    temp.int_timer = 0;
-		}
+	// read previous temperature conversion as required
+	if((temp.status & TEMP_CONV_STARTED)
+		&& !timer_active(TIMER_TEMP_CONV)) {
+	    if(temp.status & TEMP_CONV_INVALID) {
 		temp.status &= ~TEMP_CONV_STARTED;
 		temp.status &= ~TEMP_CONV_INVALID;
+	    } else {
+		temp.status |= TEMP_READ_STARTED;
+		temp_read_conv();
+		return;
 	    }
 	}
 
@@ -100,87 +134,47 @@ void temp_tick(void) {
 		|| (temp.status & TEMP_CONV_INVALID)) {
 	    temp.status |=  TEMP_CONV_STARTED;
 	    temp.status &= ~TEMP_CONV_INVALID;
-	    temp.conv_timer = TEMP_CONV_INTERVAL;
+	    timer_start(TIMER_TEMP_CONV, TEMP_CONV_INTERVAL, 0, 0);
 	    temp_start_conv();
 	}
     }
-
-    // release sensor communication lock
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	temp.status &= ~TEMP_COMM_LOCK;
-    }
 }
 
 
-// starts a new temperature conversion
+// starts a new temperature conversion; the bus is left
+// driven high to power the sensor (parasitic mode)
 void temp_start_conv(void) {
-    if(temp_reset()) {
-	temp_write_byte(TEMP_CMD_SKIPROM);
-	temp_write_byte(TEMP_CMD_CONVERTTEMP);
-	temp_power_bus();
-    } else {
-	temp.status |= TEMP_CONV_INVALID;
-    }
+    temp_ow_start(TEMP_CMD_CONVERTTEMP, 0);
 }
 
 
-// reads result of temperature conversion from scratchpad
+// starts reading result of temperature conversion from scratchpad
 void temp_read_conv(void) {
-    if(temp_reset()) {
-	temp_write_byte(TEMP_CMD_SKIPROM);
-	temp_write_byte(TEMP_CMD_RSCRATCHPAD);
-	if(!temp_read_scratch()) {
-	    temp.status |= TEMP_CONV_INVALID;
-	} else {
-	    DUMPINT(temp_degC());
-	    DUMPINT(temp_degF());
-	}
-    } else {
-	temp.status |= TEMP_CONV_INVALID;
-    }
+    temp_ow_start(TEMP_CMD_RSCRATCHPAD, TEMP_OW_READ_SIZE);
 }
 
 
-// calculate timekeeping error using last known temperature
-// (temp.temp) and time interval (temp.int_timer)
-void temp_calc_error(void) {
-    int32_t error;
-    if(temp.int_timer < 300) {
-	// use accurate method for small time intervals
-	// to minimize rounding error
-	error  = XTAL_TURNOVER_TEMP - temp.temp;
-	error *= error;
-	error *= XTAL_FREQUENCY_COEF;
-        error *= temp.int_timer;
-	temp.error += error;
-    } else {
-	// use less accurate method for large time intervals
-	// to prevent overflow (when the clock has been
-	// sleeping for more than about five minutes)
-	error  = (XTAL_TURNOVER_TEMP - (temp.temp + 0x08)) >> 4;
-	error *= error;
-	error *= XTAL_FREQUENCY_COEF;
-        error *= temp.int_timer;
-	while(error > (1000000000UL >> 7)) {
-	    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-		if(temp.adjust == 127) {
-		    temp.adjust = 0;
-		    time_tick();
-		} else {
-		    ++temp.adjust;
-		}
-	    }
-	    error -= (1000000000UL >> 7);
-	}
-	temp.error += (error << 8);
+// returns time lost per second (1 / 10^9 seconds) at last known
+// temperature, interpolated between entries of temp_xtal_error
+uint16_t temp_xtal_error_now(void) {
+    if(temp.temp == TEMP_INVALID) return 0;
+
+    int16_t t = temp.temp - TEMP_TABLE_MIN * 16;  // deg C / 16
+    if(t < 0) t = 0;
+    if(t > (TEMP_TABLE_MAX - TEMP_TABLE_MIN) * 16) {
+	t = (TEMP_TABLE_MAX - TEMP_TABLE_MIN) * 16;
     }
 
-    while(temp.error > (1000000000UL << 1)) {
-	ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	    ++temp.adjust;
-	}
-	temp.error -= (1000000000UL << 1);
+    uint8_t idx  = t >> 4;
+    uint8_t frac = t & 0x0F;
+
+    uint16_t error = pgm_read_word(&(temp_xtal_error[idx]));
+    if(frac) {
+	int16_t step = pgm_read_word(&(temp_xtal_error[idx + 1])) - error;
+	error += ((int32_t)step * frac) >> 4;
     }
+
+    return error;
 }
 
 
@@ -202,132 +196,124 @@ int16_t temp_degF(void) {
 }
 
 
-// resets the 1-Wire bus
-// returns true if successful; false otherwise
-uint8_t temp_reset(void) {
-    uint8_t response = 0;
-
-    // pull low for at least 500 us
-    PORTC &= ~_BV(PC1);  // pull low
-    DDRC  |=  _BV(PC1);  // set as output
-    _delay_us(500);
-
-    // release bus and check device response (timing critical)
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	DDRC &= ~_BV(PC1);  // set as input
-	_delay_us(80);      // wait for response
-	if(PINC & _BV(PC1)) response = 1;  // query bus
-	temp.missed_ovf += 2;
+// starts a 1-Wire transaction: reset, skip rom, send the given
+// function command, and read the given number of bytes into ow_buf
+void temp_ow_start(uint8_t cmd, uint8_t read_count) {
+    temp.ow_buf[0] = TEMP_CMD_SKIPROM;
+    temp.ow_buf[1] = cmd;
+    for(uint8_t i = TEMP_OW_WRITE_SIZE; i < sizeof(temp.ow_buf); ++i) {
+	temp.ow_buf[i] = 0;
     }
 
-    // additional 420 us delay, so bus released for at least 500 us
-    _delay_us(420);
-
-    // return true if reset successful
-    // (response is low/false if successful)
-    return !response;
-}
+    temp.ow_idx   = 0;
+    temp.ow_bit   = 0x01;
+    temp.ow_count = TEMP_OW_WRITE_SIZE + read_count;
+    temp.ow_timer = 0;
 
-
-// writes a bit to the 1-Wire bus:
-// if bit is true, writes 1; if false, writes 0
-void temp_write_bit(uint8_t bit) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	PORTC &= ~_BV(PC1);  // disable pull-up
-	DDRC  |=  _BV(PC1);  // pull low
-	_delay_us(10);
-
-	if(bit) {  // sending 1
-	    PORTC |= _BV(PC1);  // pull high
-	    _delay_us(55);      // for 55 us
-	} else {  // sending 0
-	    _delay_us(55);  // remain low for 55 us
-	    PORTC |= _BV(PC1);  // pull high
-	}
-
-	_delay_us(5);  // 5 us recovery time
-	temp.missed_ovf += 2;
+	temp.ow_state = TEMP_OW_RESET_START;
     }
 }
 
 
-// requests a bit from the 1-Wire bus;
-// returns the bit (1 or 0)
-uint8_t temp_read_bit(void) {
-    uint8_t bit = 0;
+// advances the 1-Wire state machine; called every timer0 overflow
+// (32 us) during a transaction, so interrupts are only disabled
+// for the few microseconds needed to generate each bus edge
+void temp_ow_step(void) {
+    if(temp.ow_timer && --temp.ow_timer) return;
+
+    switch(temp.ow_state) {
+	case TEMP_OW_RESET_START:
+	    // pull low for at least 480 us
+	    PORTC &= ~_BV(PC1);  // pull low
+	    DDRC  |=  _BV(PC1);  // set as output
+	    temp.ow_timer = 16;
+	    temp.ow_state = TEMP_OW_RESET_RELEASE;
+	    break;
+
+	case TEMP_OW_RESET_RELEASE:
+	    DDRC &= ~_BV(PC1);  // set as input
+	    temp.ow_timer = 2;
+	    temp.ow_state = TEMP_OW_PRESENCE;
+	    break;
+
+	case TEMP_OW_PRESENCE:
+	    // check device response ~70 us after release
+	    // (response is low if successful)
+	    _delay_us(6);
+	    if(PINC & _BV(PC1)) {
+		temp.status  |= TEMP_CONV_INVALID;
+		temp.ow_state = TEMP_OW_IDLE;
+		break;
+	    }
 
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	// initiate read timeslot
-	PORTC &= ~_BV(PC1);      // disable pull-up
-	DDRC  |=  _BV(PC1);      // pull low
-	_delay_us(3);
-
-	// wait for and read response
-	DDRC &= ~_BV(PC1);       // set to input
-	_delay_us(10);           // wait for response
-	if(PINC & _BV(PC1)) bit = 1;  // query bus
-    }
+	    // bus released for at least 480 us
+	    temp.ow_timer = 13;
+	    temp.ow_state = TEMP_OW_SLOT_START;
+	    break;
 
-    // 50 us to complete 60 us timeslot
-    _delay_us(47);
+	case TEMP_OW_SLOT_START:
+	    if(temp.ow_idx >= temp.ow_count) {
+		// transaction complete; bus remains driven high
+		temp.ow_state = TEMP_OW_IDLE;
+		break;
+	    }
 
-    // pull bus high for 5 us recovery time
-    PORTC |=  _BV(PC1);      // enable pull-up
-    DDRC  |=  _BV(PC1);      // pull low
-    _delay_us(5);
+	    PORTC &= ~_BV(PC1);  // disable pull-up
+	    DDRC  |=  _BV(PC1);  // pull low
 
-    return bit;
-}
+	    if(temp.ow_idx < TEMP_OW_WRITE_SIZE) {
+		// writing: release early to send 1; otherwise,
+		// remain low until end of timeslot to send 0
+		if(temp.ow_buf[temp.ow_idx] & temp.ow_bit) {
+		    _delay_us(5);
+		    PORTC |= _BV(PC1);  // pull high
+		}
+		temp.ow_timer = 3;
+	    } else {
+		// reading: release and sample response
+		_delay_us(3);
+		DDRC &= ~_BV(PC1);  // set to input
+		_delay_us(10);      // wait for response
+		if(PINC & _BV(PC1)) {
+		    temp.ow_buf[temp.ow_idx] |= temp.ow_bit;
+		}
+		temp.ow_timer = 2;
+	    }
 
+	    temp.ow_state = TEMP_OW_SLOT_END;
+	    break;
 
-// writes a byte to the 1-Wire bus
-void temp_write_byte(uint8_t byte) {
-    for(uint8_t i = 0; i < 8; ++i, byte >>= 1) {
-	temp_write_bit(byte & 0x01);
-	if(temp.status & TEMP_CONV_INVALID) return;
-    }
-}
+	case TEMP_OW_SLOT_END:
+	    // pull bus high for recovery time
+	    PORTC |= _BV(PC1);  // enable pull-up
+	    DDRC  |= _BV(PC1);  // push high
 
+	    temp.ow_bit <<= 1;
+	    if(!temp.ow_bit) {
+		temp.ow_bit = 0x01;
+		++temp.ow_idx;
+	    }
 
-// reads a byte from the 1-Wire bus
-uint8_t temp_read_byte(void) {
-    uint8_t byte = 0;
+	    temp.ow_timer = 1;
+	    temp.ow_state = TEMP_OW_SLOT_START;
+	    break;
 
-    for(uint8_t bit = 0x01; bit; bit <<= 1) {
-	if(temp_read_bit()) byte |= bit;
-	if(temp.status & TEMP_CONV_INVALID) return 0;
+	default:
+	    temp.ow_state = TEMP_OW_IDLE;
+	    break;
     }
-
-    return byte;
-}
-
-
-// sends power via the bus (sensor wired in parasitic mode)
-void temp_power_bus(void) {
-    PORTC |= _BV(PC1);  // enable pull-up
-    DDRC  |= _BV(PC1);  // push high
 }
 
 
-// reads the entire scratchpad
+// checks scratchpad read by the last 1-Wire transaction and
+// saves the new temperature; returns true if successful
 uint8_t temp_read_scratch(void) {
     uint8_t calculated_crc = 0;
-    int16_t new_temp  = 0;
+    const volatile uint8_t* scratch = temp.ow_buf + TEMP_OW_WRITE_SIZE;
 
-    for(uint8_t i = 0; i < 8; ++i) {
-	uint8_t byte = temp_read_byte();
-	if(temp.status & TEMP_CONV_INVALID) return 0;
-
-	switch(i) {
-	    case 0:  // temperature lsb
-		new_temp |= byte;
-		break;
-	    case 1:  // temperature msb
-		new_temp |= ((uint16_t)byte << 8);
-		break;
-	    default:
-		break;
-	}
+    for(uint8_t i = 0; i < TEMP_OW_READ_SIZE - 1; ++i) {
+	uint8_t byte = scratch[i];
 
 	// update crc with newly ready byte
 	for(uint8_t j = 0; j < 8; ++j, byte >>= 1) {
@@ -337,15 +323,14 @@ uint8_t temp_read_scratch(void) {
 	}
     }
 
-    uint8_t reported_crc = temp_read_byte();
-
-    if(!(temp.status & TEMP_CONV_INVALID)
-	    && calculated_crc == reported_crc) {
-
+    if(calculated_crc == scratch[TEMP_OW_READ_SIZE - 1]) {
 	ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	    temp.temp = new_temp;
+	    temp.temp = scratch[0] | ((uint16_t)scratch[1] << 8);
 	}
 
+	DUMPINT(temp_degC());
+	DUMPINT(temp_degF());
+
 	return 1;
     } else {
 	return 0;
@@ -13,18 +13,56 @@
 // constant value for invalid temperature
 #define TEMP_INVALID  INT16_MAX
 
+// range of crystal error table (deg C); temperatures
+// outside this range use the nearest table entry
+#define TEMP_TABLE_MIN -10
+#define TEMP_TABLE_MAX  60
+
+// time lost per second to crystal error (1 / 10^9 seconds)
+// at temperature deg (deg C) for a parabolic crystal model
+#define TEMP_XTAL_ERROR_RAW(deg) ((int32_t)XTAL_FREQUENCY_COEF \
+	* ((deg) * 16L - XTAL_TURNOVER_TEMP) \
+	* ((deg) * 16L - XTAL_TURNOVER_TEMP) / 256)
+#define TEMP_XTAL_ERROR(deg) (TEMP_XTAL_ERROR_RAW(deg) > UINT16_MAX \
+	? UINT16_MAX : (uint16_t)TEMP_XTAL_ERROR_RAW(deg))
+
+// time error equal to 1/128 second (1 / 10^9 seconds)
+#define TEMP_ERROR_PER_ADJUST (1000000000UL >> 7)
+
 #define TEMP_CONV_STARTED 0x01  // temperature conversion started
 #define TEMP_CONV_INVALID 0x02  // temperature conversion invalid
-#define TEMP_COMM_LOCK    0x04  // communicating with temp sensor
+#define TEMP_READ_STARTED 0x04  // scratchpad read started
+
+// 1-Wire bytes written (rom and function command) and
+// read (scratchpad) per transaction
+#define TEMP_OW_WRITE_SIZE 2
+#define TEMP_OW_READ_SIZE  9
+
+// 1-Wire states for temp.ow_state; the state machine advances on
+// timer0 overflows (every 32 us) and the action named by the state
+// is taken when temp.ow_timer expires
+enum {
+    TEMP_OW_IDLE,           // no transaction in progress
+    TEMP_OW_RESET_START,    // pull bus low to begin reset pulse
+    TEMP_OW_RESET_RELEASE,  // release bus after reset pulse
+    TEMP_OW_PRESENCE,       // check for presence pulse
+    TEMP_OW_SLOT_START,     // begin write or read timeslot
+    TEMP_OW_SLOT_END,       // end timeslot and drive bus high
+};
 
 typedef struct {
      int8_t status;      // status flags
-    int32_t int_timer;   // seconds between temperature readings
-    int32_t conv_timer;  // seconds until next temperature reading
     uint8_t adjust;      // necessary 1/128 second adjustments
-    int32_t error;       // time error [1 / (16^2 * 10^9) seconds]
+   uint32_t error;       // time error [1 / 10^9 seconds]
     int16_t temp;        // current temperature (16 * deg C)
-     int8_t missed_ovf;  // missed timer0 overflows
+
+    uint8_t ow_state;    // 1-Wire state machine state
+    uint8_t ow_timer;    // timer0 overflows until next state
+    uint8_t ow_idx;      // index of current byte in ow_buf
+    uint8_t ow_bit;      // mask of current bit in current byte
+    uint8_t ow_count;    // total number of bytes to write and read
+    uint8_t ow_buf[TEMP_OW_WRITE_SIZE + TEMP_OW_READ_SIZE];  // bytes
+    				// to write followed by bytes read
 } temp_t;
 
 
@@ -37,6 +75,13 @@ void temp_sleep(void);
 void temp_tick(void);
 static inline void temp_semitick(void) {};
 
+void temp_ow_step(void);
+
+// advance any 1-Wire transaction in progress (every 32 us)
+static inline void temp_semisemitick(void) {
+    if(temp.ow_state) temp_ow_step();
+}
+
 int16_t temp_degF(void);
 int16_t temp_degC(void);
 
@@ -47,6 +92,7 @@ static inline void temp_wake(void)     {};
 static inline void temp_sleep(void)    {};
 static inline void temp_tick(void)     {};
 static inline void temp_semitick(void) {};
+static inline void temp_semisemitick(void) {};
 
 #endif  // TEMPERATURE_SENSOR
 
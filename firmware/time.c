@@ -11,9 +11,13 @@
 
 
 #include "time.h"
+#include "profile.h"  // for profiling atomic blocks
 #include "usart.h"   // for debugging output
 #include "temp.h"    // for temperature compensation
 #include "system.h"  // for determining power source
+#include "gps.h"     // for gps pulse-per-second phase lock
+#include "alarm.h"   // for finding next alarm when time changes
+#include "timer.h"   // for deferring drift calculation
 
 
 // extern'ed time and date data
@@ -51,7 +55,26 @@ uint8_t ee_time_timeformat_idx   EEMEM = TIME_TIMEFORMAT_HH_MM_SS;
 
 // drift adjustment data
 #ifndef AUTODRIFT_CONSTANT
+#ifdef AUTODRIFT_LEAST_SQUARES
+// each drift sample is the number of seconds between time sets and
+// the resulting time error in 1/128 seconds; a preloaded drift
+// correction is stored as a sample with a one second error
 #ifdef AUTODRIFT_PRELOAD
+uint8_t  ee_time_drift_count EEMEM = 1;
+uint8_t  ee_time_drift_idx   EEMEM = 1;
+uint32_t ee_time_drift_interval_table[] EEMEM
+    = { (AUTODRIFT_PRELOAD < 0 ? -AUTODRIFT_PRELOAD : AUTODRIFT_PRELOAD)
+	* 128UL, [1 ... TIME_DRIFT_TABLE_SIZE - 1] = 0 };
+int32_t  ee_time_drift_error_table[] EEMEM
+    = { (AUTODRIFT_PRELOAD < 0 ? -128 : 128),
+	[1 ... TIME_DRIFT_TABLE_SIZE - 1] = 0 };
+#else
+uint8_t  ee_time_drift_count EEMEM = 0;
+uint8_t  ee_time_drift_idx   EEMEM = 0;
+uint32_t ee_time_drift_interval_table[TIME_DRIFT_TABLE_SIZE] EEMEM;
+int32_t  ee_time_drift_error_table[TIME_DRIFT_TABLE_SIZE] EEMEM;
+#endif  // AUTODRIFT_PRELOAD
+#elif defined(AUTODRIFT_PRELOAD)
 uint8_t ee_time_drift_count EEMEM = 1;
 uint8_t ee_time_drift_idx   EEMEM = 1;
 int16_t ee_time_drift_table[] EEMEM
@@ -60,7 +83,7 @@ int16_t ee_time_drift_table[] EEMEM
 uint8_t ee_time_drift_count EEMEM = 0;
 uint8_t ee_time_drift_idx   EEMEM = 0;
 int16_t ee_time_drift_table[TIME_DRIFT_TABLE_SIZE] EEMEM;
-#endif  // AUTODRIFT_PRELOAD
+#endif  // AUTODRIFT_LEAST_SQUARES / AUTODRIFT_PRELOAD
 #endif  // ~AUTODRIFT_CONSTANT
 
 
@@ -78,6 +101,7 @@ void time_init(void) {
     // for month and day, zero is an invalid value
     if(time.month == 0) time.month = 1;
     if(time.day   == 0) time.day   = 1;
+    time_bcdsync();
 
 
 #ifdef AUTODRIFT_CONSTANT
@@ -85,11 +109,14 @@ void time_init(void) {
     time.drift_adjust_timer = 0;
 #else  // ~AUTODRIFT_CONSTANT
     // load drift_adjust
+#ifdef AUTODRIFT_LEAST_SQUARES
+    time_loaddriftfit();
+#else
     time_loaddriftmedian();
+#endif  // AUTODRIFT_LEAST_SQUARES
 
     // explicitly initialize drift variables
     time.drift_adjust_timer  = 0;
-    time.drift_delay_timer   = 0;
     time.drift_total_seconds = 0;
     time.drift_frac_seconds  = 0;
     time.drift_delta_seconds = 0;
@@ -134,6 +161,15 @@ void time_wake(void) {
     // waking, the watchdog timer will reset the system and the system will
     // (hopefully) load the correct time after reset
     time_savetime();
+
+#ifndef AUTODRIFT_CONSTANT
+    // resume drift delay where it stopped when sleep began
+    if(time.drift_delay_remaining) {
+	timer_start(TIMER_DRIFT_DELAY, time.drift_delay_remaining, 0,
+		    time_driftdelay);
+	time.drift_delay_remaining = 0;
+    }
+#endif  // ~AUTODRIFT_CONSTANT
 }
 
 
@@ -145,6 +181,15 @@ void time_sleep(void) {
     // will still have a semi-reasonable time.
     time_savetime();
     time_savedate();
+
+#ifndef AUTODRIFT_CONSTANT
+    // stop drift delay during sleep, so the time may still be
+    // corrected before the delay expires once power returns
+    if(timer_active(TIMER_DRIFT_DELAY)) {
+	time.drift_delay_remaining = timer_remaining(TIMER_DRIFT_DELAY);
+	timer_stop(TIMER_DRIFT_DELAY);
+    }
+#endif  // ~AUTODRIFT_CONSTANT
 }
 
 
@@ -208,20 +253,81 @@ void time_loadtimeformat(void) {
 }
 
 
-// set current time
-void time_settime(uint8_t hour, uint8_t minute, uint8_t second) {
+// take a consistent snapshot of the current time and fractional seconds
+void time_now_frac(time_frac_t* now) {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	uint8_t frac = TCNT2;
+
+	// if the per-second interrupt is pending, time has not yet
+	// been incremented, so report the end of the previous second
+	if(TIFR2 & _BV(OCF2B)) frac = OCR2A;
+
+	now->hour   = time.hour;
+	now->minute = time.minute;
+	now->second = time.second;
+	now->frac   = frac;
+    }
+}
+
+
+// copy current date and time without disabling interrupts; writers
+// increment time.seq, so the copy is repeated if the time changes
+// while it is being made; returns the generation of the copy
+uint8_t time_snapshot(time_snap_t* snap) {
+    uint8_t seq;
+
+    do {
+	seq = time.seq;
+
+	snap->year   = time.year;
+	snap->month  = time.month;
+	snap->day    = time.day;
+	snap->hour   = time.hour;
+	snap->minute = time.minute;
+	snap->second = time.second;
+#ifdef TIME_BCD
+	snap->bcd_hour   = time.bcd_hour;
+	snap->bcd_minute = time.bcd_minute;
+	snap->bcd_second = time.bcd_second;
+#endif  // TIME_BCD
+    } while(seq != time.seq);
+
+    return seq;
+}
+
+
+#ifdef TIME_BCD
+// recompute packed-bcd time from binary time after the time is
+// set (division is fine here; time_tick() carries nibbles instead)
+// ***interrupts must be disabled while calling this function***
+void time_bcdsync(void) {
+    time.bcd_hour   = ((time.hour   / 10) << 4) | (time.hour   % 10);
+    time.bcd_minute = ((time.minute / 10) << 4) | (time.minute % 10);
+    time.bcd_second = ((time.second / 10) << 4) | (time.second % 10);
+}
+#endif  // TIME_BCD
+
+
+// set current time, including fractional seconds (1/128 seconds)
+void time_settime_frac(uint8_t hour, uint8_t minute, uint8_t second,
+		       uint8_t frac) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	++time.seq;
+
+	// fraction must not pass compare match or timer would wrap
+	if(frac > OCR2A) frac = OCR2A;
+
 	GTCCR |= _BV(PSRSYNC);      // reset timer prescaler
 #ifndef AUTODRIFT_CONSTANT
 	uint8_t TCNT2_old = TCNT2;  // save fractional seconds
 #endif  // ~AUTODRIFT_CONSTANT
-	TCNT2 = 0;                  // reset fractional seconds
+	TCNT2 = frac;               // set fractional seconds
 
 #ifndef AUTODRIFT_CONSTANT
 	// defer setting drift adjustment to allow correction of an
-	// incorrectly set time; also ensures calls to autodrift
-	// below will not process any delayed time correction
-	time.drift_delay_timer = TIME_DRIFT_SAVE_DELAY;
+	// incorrectly set time
+	timer_start(TIMER_DRIFT_DELAY, TIME_DRIFT_SAVE_DELAY, 0,
+		    time_driftdelay);
 
 	if(TIFR2 & _BV(OCF2A)) {  // if missed second
 	    time_autodrift();     // process missed second
@@ -230,8 +336,15 @@ void time_settime(uint8_t hour, uint8_t minute, uint8_t second) {
 	    TCNT2_old = 0;	  // assume at second start
 	}
 
-	// maintain count of lost fractional seconds
-	time.drift_frac_seconds += TCNT2_old;
+	// maintain count of lost fractional seconds; if the new
+	// fraction is larger, borrow a second from the old time
+	uint8_t borrowed = FALSE;
+	if(time.drift_frac_seconds + TCNT2_old < frac) {
+	    time.drift_frac_seconds += 128;
+	    --time.second;  // subtract from current time (ok if <0)
+	    borrowed = TRUE;
+	}
+	time.drift_frac_seconds += TCNT2_old - frac;
 
 	// since crystal timer prescaler is reset, we lose (on average)
 	// half of a fractional second each time the time is set, so
@@ -239,17 +352,22 @@ void time_settime(uint8_t hour, uint8_t minute, uint8_t second) {
 	if(time.second & 0x01) ++time.drift_frac_seconds;
 
 	// when fractional seconds make one full second, process
-	// the missed second with the drift correction code
+	// the missed second with the drift correction code; a
+	// borrowed second is only given back, since it never passed
 	if(time.drift_frac_seconds >= 127) {
 	    time.drift_frac_seconds -= 127;
-	    time_autodrift();  // process missed second
+	    if(!borrowed) time_autodrift();  // process missed second
 	    ++time.second;     // add to current time (ok if >60)
+	} else if(borrowed) {
+	    // the borrowed second was counted as elapsed
+	    --time.drift_total_seconds;
 	}
 
 	// determine if clock drift estimate should be computed
 	if(time.status & TIME_UNSET) {
 	    // reset drift monitoring statistics
-	    time.drift_delay_timer   = 0;
+	    timer_stop(TIMER_DRIFT_DELAY);
+	    time.drift_delay_remaining = 0;
 	    time.drift_total_seconds = 0;
 	    time.drift_frac_seconds  = 0;
 	    time.drift_delta_seconds = 0;
@@ -284,10 +402,13 @@ void time_settime(uint8_t hour, uint8_t minute, uint8_t second) {
 	time.hour   = hour;
 	time.minute = minute;
 	time.second = second;
+	time_bcdsync();
 
 	// ensure unset flag is cleared
 	time.status &= ~TIME_UNSET;
     }
+
+    alarm_newtime();
 }
 
 
@@ -296,26 +417,36 @@ void time_setdate(uint8_t year, uint8_t month, uint8_t day) {
     time.status &= ~TIME_UNSET;
 
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	++time.seq;
 	time.year   = year;
 	time.month  = month;
 	time.day    = day;
     }
+
+    alarm_newtime();
 }
 
 
 // add one second to current time
 void time_tick(void) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	++time.seq;
 	++time.second;
+	TIME_BCD_SET(time.bcd_second, time_bcdinc(time.bcd_second));
 
 	if(time.second >= 60) {
 	    time.second = 0;
 	    ++time.minute;
+	    TIME_BCD_SET(time.bcd_second, 0);
+	    TIME_BCD_SET(time.bcd_minute, time_bcdinc(time.bcd_minute));
 	    if(time.minute >= 60) {
 		time.minute = 0;
 		++time.hour;
+		TIME_BCD_SET(time.bcd_minute, 0);
+		TIME_BCD_SET(time.bcd_hour, time_bcdinc(time.bcd_hour));
 		if(time.hour >= 24) {
 		    time.hour = 0;
+		    TIME_BCD_SET(time.bcd_hour, 0);
 		    ++time.day;
 		    eeprom_write_byte(&ee_time_day, time.day);
 		    if(time.day > time_daysinmonth(time.year, time.month)) {
@@ -338,6 +469,13 @@ void time_tick(void) {
 
     // run drift correction
     time_autodrift();
+
+#ifdef GPS_PPS
+    // lengthen or shorten next "second" to track gps pulses; the
+    // loop steps once per second here, not again for seconds which
+    // time_settime_frac() processes through time_autodrift()
+    OCR2A += gps_pll_tick();
+#endif  // GPS_PPS
 }
 
 
@@ -488,7 +626,10 @@ void time_dston(uint8_t adj_time) {
     if(!(time.status & TIME_DST)) {
 	time.status |= TIME_DST;  // set dst
 	time_savestatus();        // and save
-	if(adj_time) time_springforward();
+	if(adj_time) {
+	    time_springforward();
+	    alarm_newtime();
+	}
     }
 }
 
@@ -499,7 +640,10 @@ void time_dstoff(uint8_t adj_time) {
     if(time.status & TIME_DST) {
 	time.status &= ~TIME_DST;  // unset dst
 	time_savestatus();         // and save
-	if(adj_time) time_fallback();
+	if(adj_time) {
+	    time_fallback();
+	    alarm_newtime();
+	}
     }
 }
 
@@ -508,9 +652,11 @@ void time_dstoff(uint8_t adj_time) {
 // (in the spring, clocks "spring forward")
 void time_springforward(void) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	++time.seq;
 	++time.hour;
-	if(time.hour < 24) return;
-	time.hour = 0;
+	if(time.hour >= 24) time.hour = 0;
+	time_bcdsync();
+	if(time.hour) return;
 
 	++time.day;
 	if(time.day <= time_daysinmonth(time.year, time.month)) return;
@@ -533,11 +679,13 @@ void time_springforward(void) {
 // (in the fall, clocks "fall back")
 void time_fallback(void) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	++time.seq;
+
 	// if time.hour is 0, underflow will make it 255
 	--time.hour;
-
-	if(time.hour < 24) return;
-	time.hour = 23;
+	if(time.hour >= 24) time.hour = 23;
+	time_bcdsync();
+	if(time.hour != 23) return;
 
 	--time.day;
 	if(time.day > 0) return;
@@ -748,7 +896,7 @@ void time_autodrift(void) {
     }
 
 #ifdef AUTODRIFT_SLEEP
-    if(system.status & SYSTEM_SLEEP) {
+    if(HOTFLAG_TEST(SYSTEM_SLEEP)) {
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
 	    if(time.drift_sleepadjust_timer) {
 		// seconds until next drift correction
@@ -776,38 +924,41 @@ void time_autodrift(void) {
 #endif  // AUTODRIFT_SLEEP
 
     OCR2A = next_OCR2A;  // set next OCR2A value
+}
+
 
-    if(system.status & SYSTEM_SLEEP) {
+#ifndef AUTODRIFT_CONSTANT
+// called when drift delay timer expires to
+// calculate and store new adjustment and update drift_adjust
+void time_driftdelay(void) {
+    if(HOTFLAG_TEST(SYSTEM_SLEEP)) {
 	// if drift adjustment calculation is pending,
 	// defer it until external power restored
+	time.drift_delay_remaining = 1;
 	return;
     }
 
-
-#ifndef AUTODRIFT_CONSTANT
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-	// if drift adjustment calculation deferred and timer expires,
-	// calculate and store new adjustment and update drift_adjust
-	if(time.drift_delay_timer) {
-	    --time.drift_delay_timer;
-	    if(!time.drift_delay_timer) {
-		// calculate and save new drift adjustment
-		time_newdrift();
-
-		// load new median adjustment
-		time_loaddriftmedian();
-	    }
-	}
+	// calculate and save new drift adjustment
+	time_newdrift();
+
+#ifdef AUTODRIFT_LEAST_SQUARES
+	// fit new adjustment to saved drift samples
+	time_loaddriftfit();
+#else
+	// load new median adjustment
+	time_loaddriftmedian();
+#endif  // AUTODRIFT_LEAST_SQUARES
     }
-#endif  // ~AUTODRIFT_CONSTANT
 }
 
 
-#ifndef AUTODRIFT_CONSTANT
 // calculates and saves new drift value
 // ***interrupts must be disabled while calling this function***
 void time_newdrift(void) {
+#ifndef AUTODRIFT_LEAST_SQUARES
     int32_t new_adj;  // new drift adjustment value
+#endif
 
     // disregard monitored drift data if time change too large
     // (maybe user mixed up timezones, mixed up am and pm, etc.)
@@ -819,7 +970,45 @@ void time_newdrift(void) {
 	time.drift_delta_seconds = 0;
 	return;
     }
-    
+
+#ifdef AUTODRIFT_LEAST_SQUARES
+    // defer saving a sample until enough time has passed to measure
+    // drift; small time changes are kept since the fit weights each
+    // sample by the length of its interval
+    if(time.drift_total_seconds < TIME_DRIFT_MIN_INTERVAL) return;
+
+    // time error in 1/128 seconds, excluding the effect of
+    // the current drift adjustment, if any
+    int32_t error = time.drift_delta_seconds << 7;
+    if(time.drift_adjust) {
+	error += time.drift_total_seconds / time.drift_adjust;
+    }
+
+    uint32_t interval = time.drift_total_seconds;
+
+    // reset drift monitor variables
+    time.drift_total_seconds = 0;
+    time.drift_frac_seconds  = 0;
+    time.drift_delta_seconds = 0;
+
+    // do not record if the clock appears to run very fast or very
+    // slow (more than ~200 ppm)...probably a mistake...
+    if((error < 0 ? -error : error) * TIME_MIN_DRIFT_ADJUST > interval) {
+	return;
+    }
+
+    // save drift sample
+    uint8_t idx   = eeprom_read_byte(&ee_time_drift_idx  );
+    uint8_t count = eeprom_read_byte(&ee_time_drift_count);
+    idx %= TIME_DRIFT_TABLE_SIZE;
+    eeprom_write_dword(&(ee_time_drift_interval_table[idx]), interval);
+    eeprom_write_dword((uint32_t*)&(ee_time_drift_error_table[idx]), error);
+    ++idx;
+    if(count < idx) count = idx;
+    idx %= TIME_DRIFT_TABLE_SIZE;
+    eeprom_write_byte(&ee_time_drift_idx,   idx);
+    eeprom_write_byte(&ee_time_drift_count, count);
+#else  // ~AUTODRIFT_LEAST_SQUARES
     // defer calculation of new adjustment if time change too small
     // (maybe user accidently entered set time mode, hit "set" three times,
     //  and only changed current time by a small amount; also, recording only
@@ -866,7 +1055,113 @@ void time_newdrift(void) {
     idx %= TIME_DRIFT_TABLE_SIZE;
     eeprom_write_byte(&ee_time_drift_idx,   idx);
     eeprom_write_byte(&ee_time_drift_count, count);
+#endif  // AUTODRIFT_LEAST_SQUARES
+}
+
+
+#ifdef AUTODRIFT_LEAST_SQUARES
+// returns num * scale / den; to prevent overflow, low-order bits
+// of num and den are discarded as necessary
+static uint32_t time_scaledratio(uint32_t num, uint32_t scale,
+				 uint32_t den) {
+    if(!scale) return 0;
+
+    uint32_t num_max = UINT32_MAX / scale;
+    while(num > num_max) {
+	num >>= 1;
+	den >>= 1;
+    }
+
+    if(!den) return UINT32_MAX;
+
+    return num * scale / den;
+}
+
+
+// returns the integer square root of n
+static uint16_t time_isqrt(uint32_t n) {
+    uint16_t root = 0;
+
+    for(uint16_t bit = 0x8000; bit; bit >>= 1) {
+	uint16_t trial = root | bit;
+	if((uint32_t)trial * trial <= n) root = trial;
+    }
+
+    return root;
+}
+
+
+// fit drift correction to drift samples in memory
+void time_loaddriftfit(void) {
+    uint8_t count = eeprom_read_byte(&ee_time_drift_count);
+    if(count > TIME_DRIFT_TABLE_SIZE) count = TIME_DRIFT_TABLE_SIZE;
+
+    // weighted least-squares fit of error = rate * interval where
+    // the weight of each sample is proportional to its interval:
+    // rate = sum(error) / sum(interval)
+    uint32_t sum_interval = 0;
+    int32_t  sum_error    = 0;
+
+    for(uint8_t i = 0; i < count; ++i) {
+	sum_interval += eeprom_read_dword(&(ee_time_drift_interval_table[i]));
+	sum_error    += eeprom_read_dword(
+			    (uint32_t*)&(ee_time_drift_error_table[i]));
+    }
+
+    // drift adjustment is the inverse of the rate
+    // (0 means no drift correction)
+    int32_t new_adj = 0;
+    if(sum_error) new_adj = (int32_t)sum_interval / sum_error;
+    if(new_adj > INT16_MAX) new_adj = INT16_MAX;
+    if(new_adj < INT16_MIN) new_adj = INT16_MIN;
+
+    // estimate variance of the fitted error from residuals, plus the
+    // error of setting the time by hand for each sample
+    uint32_t abs_sum_error = (sum_error < 0 ? -sum_error : sum_error);
+    uint32_t residual_sq = 0;
+
+    for(uint8_t i = 0; i < count; ++i) {
+	uint32_t interval = eeprom_read_dword(
+				&(ee_time_drift_interval_table[i]));
+	int32_t  error    = eeprom_read_dword(
+				(uint32_t*)&(ee_time_drift_error_table[i]));
+
+	int32_t fitted = time_scaledratio(interval, abs_sum_error,
+					  sum_interval);
+	if(sum_error < 0) fitted = -fitted;
+
+	int32_t residual = error - fitted;
+	if(residual < 0) residual = -residual;
+	if(residual > 0x3FFF) residual = 0x3FFF;  // prevents overflow
+
+	residual_sq += residual * residual;
+    }
+
+    if(count > 1) residual_sq = residual_sq / (count - 1) * count;
+    residual_sq += (uint32_t)count
+		   * TIME_DRIFT_SET_ERROR * TIME_DRIFT_SET_ERROR;
+
+    // half-width of ~95% confidence interval (two standard errors)
+    // converted from 1/128 seconds per interval to ppb
+    uint32_t confidence = TIME_DRIFT_UNKNOWN;
+    if(count) {
+	confidence = time_scaledratio(2 * time_isqrt(residual_sq),
+				      1000000000UL >> 7, sum_interval);
+	if(confidence > TIME_DRIFT_UNKNOWN) confidence = TIME_DRIFT_UNKNOWN;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	time.drift_adjust = new_adj;
+	time.drift_confidence = confidence;
+
+	if(time.drift_adjust > 0) {
+	    time.drift_adjust_timer =  time.drift_adjust;
+	} else {
+	    time.drift_adjust_timer = -time.drift_adjust;
+	}
+    }
 }
+#else  // ~AUTODRIFT_LEAST_SQUARES
 
 
 // load drift correction from memory
@@ -912,4 +1207,5 @@ void time_loaddriftmedian(void) {
 	}
     }
 }
+#endif  // AUTODRIFT_LEAST_SQUARES
 #endif  // ~AUTODRIFT_CONSTANT
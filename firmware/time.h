@@ -54,6 +54,13 @@
 #define TIME_MIN_DRIFT_TIME   15   // seconds
 #define TIME_DRIFT_SAVE_DELAY 600  // seconds (10 min)
 
+#ifdef AUTODRIFT_LEAST_SQUARES
+// least-squares drift estimation parameters
+#define TIME_DRIFT_MIN_INTERVAL 3600  // seconds (1 hour)
+#define TIME_DRIFT_SET_ERROR    64    // 1/128 seconds (typical manual set error)
+#define TIME_DRIFT_UNKNOWN      UINT16_MAX  // confidence when no data
+#endif  // AUTODRIFT_LEAST_SQUARES
+
 // flags for time.status
 #define TIME_UNSET		0x01
 #define TIME_DST		0x02
@@ -126,6 +133,16 @@ typedef struct {
     uint8_t minute;  // minutes past hour   (0 at midnight)
     uint8_t second;  // seconds past minute (0 at midnight)
 
+#ifdef TIME_BCD
+    // packed-bcd copies of hour, minute, and second (0x59 for 59)
+    uint8_t bcd_hour;
+    uint8_t bcd_minute;
+    uint8_t bcd_second;
+#endif  // TIME_BCD
+
+    uint8_t seq;  // generation counter; incremented with interrupts
+    // disabled whenever the date or time changes (see time_snapshot())
+
     int16_t drift_adjust; // current drift adjustment; abs(drift_adjust) is
     // the number of seconds that pass before time should be adjusted by 1/128
     // seconds; positive values indicate the clock is fast; negative values,
@@ -149,14 +166,43 @@ typedef struct {
     // sets, so if no drift adjustment is currently being made, drift would be
     // [drift (ppm)] = 1000000 * [drift_delta_seconds] / [drift_delta_timer]
 
-    uint16_t drift_delay_timer;  // seconds until system computes a new
-    // drift adjustment using drift_delta_seconds and drift_total_seconds
-
     uint8_t drift_frac_seconds;  // monitors fractional seconds from time sets
+
+    uint16_t drift_delay_remaining;  // seconds left on TIMER_DRIFT_DELAY
+    // when sleep began; the delay does not count down during sleep
+
+#ifdef AUTODRIFT_LEAST_SQUARES
+    uint16_t drift_confidence;  // half-width of ~95% confidence interval
+    // for the drift estimate in ppb; TIME_DRIFT_UNKNOWN if no estimate
+#endif  // AUTODRIFT_LEAST_SQUARES
 #endif  // ~AUTODRIFT_CONSTANT
 } time_t;
 
 
+// snapshot of current time, including fractional seconds
+typedef struct {
+    uint8_t hour;    // hours past midnight
+    uint8_t minute;  // minutes past hour
+    uint8_t second;  // seconds past minute
+    uint8_t frac;    // 1/128 seconds past second
+} time_frac_t;
+
+// consistent copy of the current date and time from time_snapshot()
+typedef struct {
+    uint8_t year;    // years past 2000
+    uint8_t month;   // month (1 during january)
+    uint8_t day;     // day of month (1 on the first)
+    uint8_t hour;    // hours past midnight
+    uint8_t minute;  // minutes past hour
+    uint8_t second;  // seconds past minute
+#ifdef TIME_BCD
+    uint8_t bcd_hour;    // packed-bcd hour
+    uint8_t bcd_minute;  // packed-bcd minute
+    uint8_t bcd_second;  // packed-bcd second
+#endif  // TIME_BCD
+} time_snap_t;
+
+
 extern volatile time_t time;
 
 
@@ -168,6 +214,21 @@ void time_sleep(void);
 void time_tick(void);
 static inline void time_semitick(void) {};
 
+#ifdef TIME_BCD
+void time_bcdsync(void);
+
+// returns packed-bcd value plus one, carrying into the tens nibble
+static inline uint8_t time_bcdinc(uint8_t bcd) {
+    ++bcd;
+    if((bcd & 0x0F) > 9) bcd += 0x10 - 10;
+    return bcd;
+}
+#define TIME_BCD_SET(field, value) ((field) = (value))
+#else
+static inline void time_bcdsync(void) {};
+#define TIME_BCD_SET(field, value)
+#endif  // TIME_BCD
+
 void time_savetime(void);
 void time_savedate(void);
 
@@ -180,7 +241,15 @@ void time_loaddateformat(void);
 void time_savetimeformat(void);
 void time_loadtimeformat(void);
 
-void time_settime(const uint8_t hour, const uint8_t minute, const uint8_t second);
+void time_now_frac(time_frac_t* now);
+uint8_t time_snapshot(time_snap_t* snap);
+
+void time_settime_frac(const uint8_t hour, const uint8_t minute,
+		       const uint8_t second, uint8_t frac);
+static inline void time_settime(const uint8_t hour, const uint8_t minute,
+				const uint8_t second) {
+    time_settime_frac(hour, minute, second, 0);
+}
 void time_setdate(uint8_t year, uint8_t month, uint8_t day);
 
 uint8_t time_dayofweek(uint8_t year, uint8_t month, uint8_t day);
@@ -200,8 +269,13 @@ uint8_t time_isdst_usa(void);
 void time_autodrift(void);
 
 #ifndef AUTODRIFT_CONSTANT
+void time_driftdelay(void);
 void time_newdrift(void);
+#ifdef AUTODRIFT_LEAST_SQUARES
+void time_loaddriftfit(void);
+#else
 void time_loaddriftmedian(void);
+#endif  // AUTODRIFT_LEAST_SQUARES
 #endif  // ~AUTODRIFT_CONSTANT
 
 #endif
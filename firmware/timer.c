@@ -0,0 +1,150 @@
+// timer.c  --  per-second deadline timers (timer wheel)
+//
+// Modules start one-shot or periodic timers with timer_start() instead
+// of decrementing countdown fields every second.  Each timer is linked
+// into the wheel slot for its expiration second, so timer_tick() only
+// examines the timers in one slot.
+//
+
+
+#include <avr/io.h>        // for using avr register names
+#include <util/atomic.h>   // for non-interruptable blocks
+
+
+#include "timer.h"
+#include "profile.h"  // for profiling atomic blocks
+
+
+// extern'ed timer data
+volatile timer_t timer;
+
+
+// private function declarations
+void timer_link(uint8_t id);
+void timer_unlink(uint8_t id);
+
+
+// clear timer wheel
+void timer_init(void) {
+    timer.now    = 0;
+    timer.active = 0;
+
+    for(uint8_t i = 0; i < TIMER_WHEEL_SIZE; ++i) {
+	timer.wheel[i] = TIMER_NONE;
+    }
+}
+
+
+// fire expired timers, once per second
+void timer_tick(void) {
+    uint8_t slot, id;
+
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	++timer.now;
+	slot = timer.now & (TIMER_WHEEL_SIZE - 1);
+	id = timer.wheel[slot];
+    }
+
+    while(id != TIMER_NONE) {
+	timer_callback_t callback = 0;
+
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	    // timers in this slot may expire in later turns of the wheel
+	    if(timer.due[id] == timer.now) {
+		timer_unlink(id);
+
+		if(timer.period[id]) {
+		    timer.due[id] += timer.period[id];
+		    timer_link(id);
+		} else {
+		    timer.active &= ~_BV(id);
+		}
+
+		callback = timer.callback[id];
+
+		// the timer was unlinked, so restart from slot head;
+		// expired timers are no longer due, so each fires only once
+		id = timer.wheel[slot];
+	    } else {
+		// read in the same block as the due check, as interrupts
+		// may restart timers and relink them between blocks
+		id = timer.next[id];
+	    }
+	}
+
+	if(callback) {
+	    // callback may restart or stop any timer, so rescan slot
+	    callback();
+	    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		id = timer.wheel[slot];
+	    }
+	}
+    }
+}
+
+
+// start (or restart) timer id to expire in delay seconds (at least
+// one) and call callback, if not null; if period is nonzero, the
+// timer restarts and expires again every period seconds
+void timer_start(uint8_t id, uint16_t delay, uint16_t period,
+		 timer_callback_t callback) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	if(timer.active & _BV(id)) timer_unlink(id);
+
+	timer.due[id]      = timer.now + delay;
+	timer.period[id]   = period;
+	timer.callback[id] = callback;
+
+	timer_link(id);
+	timer.active |= _BV(id);
+    }
+}
+
+
+// stop timer id without calling its callback
+void timer_stop(uint8_t id) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	if(timer.active & _BV(id)) {
+	    timer_unlink(id);
+	    timer.active &= ~_BV(id);
+	}
+    }
+}
+
+
+// returns seconds until active timer id expires
+uint16_t timer_remaining(uint8_t id) {
+    uint16_t remaining;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	remaining = timer.due[id] - timer.now;
+    }
+
+    return remaining;
+}
+
+
+// add timer id to the wheel slot for its expiration second
+// ***interrupts must be disabled while calling this function***
+void timer_link(uint8_t id) {
+    uint8_t slot = timer.due[id] & (TIMER_WHEEL_SIZE - 1);
+
+    timer.next[id]    = timer.wheel[slot];
+    timer.wheel[slot] = id;
+}
+
+
+// remove timer id from its wheel slot
+// ***interrupts must be disabled while calling this function***
+void timer_unlink(uint8_t id) {
+    volatile uint8_t* link = &(timer.wheel[timer.due[id]
+					   & (TIMER_WHEEL_SIZE - 1)]);
+
+    while(*link != TIMER_NONE) {
+	if(*link == id) {
+	    *link = timer.next[id];
+	    return;
+	}
+	link = &(timer.next[*link]);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>  // for using standard integer types
+#include <avr/io.h>  // for the _BV() macro
+
+#include "config.h"  // for configuration macros
+
+
+// timer identifiers; each module owns its timers
+// (at most eight, one bit each in timer.active)
+enum {
+    TIMER_DISPLAY_OFF,  // display stays on until expired
+#ifndef AUTODRIFT_CONSTANT
+    TIMER_DRIFT_DELAY,  // computes new drift adjustment when expired
+#endif  // ~AUTODRIFT_CONSTANT
+#ifdef TEMPERATURE_SENSOR
+    TIMER_TEMP_CONV,    // temperature conversion complete when expired
+#endif  // TEMPERATURE_SENSOR
+#ifdef GPS_TIMEKEEPING
+    TIMER_GPS_DATA,     // active while gps data is being received
+    TIMER_GPS_WARN,     // active while gps has signal
+#ifdef GPS_PPS
+    TIMER_GPS_PPS,      // active while pps pulses are being received
+#endif  // GPS_PPS
+#endif  // GPS_TIMEKEEPING
+#ifdef CRITICAL_PROFILE
+    TIMER_PROFILE,      // periodically dumps critical section profile
+#endif  // CRITICAL_PROFILE
+    TIMER_COUNT,
+};
+
+// fails to compile if timer.active cannot hold a bit for each timer
+typedef char timer_count_check[(TIMER_COUNT <= 8) ? 1 : -1];
+
+// number of slots in timer wheel (power of two); timers are kept in
+// the slot for their expiration second, so each tick only examines
+// timers which expire at that second or a multiple of
+// TIMER_WHEEL_SIZE seconds later
+#define TIMER_WHEEL_SIZE 16
+
+// marks the end of a list of timers in a wheel slot
+#define TIMER_NONE 0xFF
+
+
+// function called when a timer expires
+typedef void (*timer_callback_t)(void);
+
+
+typedef struct {
+    uint16_t now;  // seconds since startup (wraps around)
+
+    uint8_t  active;  // bit set for each active timer
+
+    uint8_t  wheel[TIMER_WHEEL_SIZE];  // first timer in each slot
+    uint8_t  next[TIMER_COUNT];        // next timer in same slot
+
+    uint16_t due[TIMER_COUNT];     // expiration second for each timer
+    uint16_t period[TIMER_COUNT];  // restart period (0 for one-shot)
+    timer_callback_t callback[TIMER_COUNT];  // called on expiration
+} timer_t;
+
+
+extern volatile timer_t timer;
+
+
+void timer_init(void);
+
+void timer_tick(void);
+
+void timer_start(uint8_t id, uint16_t delay, uint16_t period,
+		 timer_callback_t callback);
+void timer_stop(uint8_t id);
+uint16_t timer_remaining(uint8_t id);
+
+// returns true if timer has been started and has not expired
+static inline uint8_t timer_active(uint8_t id) {
+    return timer.active & _BV(id);
+}
+
+#endif  // TIMER_H
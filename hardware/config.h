@@ -103,6 +103,23 @@
 #define GPS_LOST_ERROR_MSG
 
 
+// GPS PULSE-PER-SECOND
+//
+// GPS modules with a pulse-per-second (PPS) output, such as the
+// Adafruit Ultimate GPS Module, mark the start of each second to
+// within a microsecond, while the time sentences arrive some time
+// later.  Defining GPS_PPS enables a PPS input on the otherwise unused
+// PB4 pin, and a phase-locked loop keeps the clock within 1/128
+// second of UTC by slightly lengthening or shortening seconds.  PLL
+// corrections are also recorded as drift, so the drift correction
+// learns the crystal error while the GPS is connected.  This option
+// requires GPS_TIMEKEEPING and is incompatible with the IV-18 to-spec
+// hack on the Adafruit design, which uses PB4 for the BLANK pin.
+//
+//
+// #define GPS_PPS
+
+
 // USART BAUD RATE
 //
 // The USART baud rate defined below is used for both the debugging
@@ -147,7 +164,9 @@
 // turnover temperature of 25 deg C and a frequency coefficient of
 // -0.034 ppm / (deg C)^2, XTAL_TURNOVER_TEMP should be defined as 400
 // (25 * 16), and XTAL_FREQUENCY_COEF should be defined as 34
-// (-0.034 * -1000).
+// (-0.034 * -1000).  These values generate a table of crystal error
+// per degree C (temp_xtal_error in temp.c), which may instead be
+// filled with values measured for a particular crystal.
 //
 // The technique for software temperature compensation is described in
 // the following thread:
@@ -178,6 +197,20 @@
 // #define BDAY_ALARM_DAY   1
 
 
+// NUMBER OF ALARMS
+//
+// The clock has three alarms by default.  Defining ALARM_COUNT below
+// allows up to 99 alarms, for example for shift-change chimes.  Alarms
+// are kept in EEPROM sorted by time of day, so the number of alarms
+// does not affect the cost of checking for alarms every second.  Each
+// alarm uses three bytes of EEPROM.  When choosing an alarm to set,
+// holding the button which steps to the next alarm skips ten alarms
+// at a time.
+//
+//
+// #define ALARM_COUNT 24
+
+
 // DISPLAY BRIGHTNESS / BOOST CONFIGURATION
 //
 // VFD displays lose brightness as they age, but increasing the
@@ -206,6 +239,20 @@
 // #define OCR0A_SCALE 14
 // #define OCR0A_MAX OCR0A_MIN + 10 * OCR0A_SCALE
 
+// A display showing few lit segments draws little current from the
+// boost converter, so its voltage sags less than with all segments
+// lit.  Defining BOOST_LOAD_TRIM lowers OCR0A as fewer segments are
+// lit to keep brightness even, saving boost power and tube wear.
+// The value is the percentage of (OCR0A - OCR0A_MIN) removed when no
+// segments are lit; the trim shrinks linearly to zero with all
+// segments lit.  The fixed OCR0A_VALUE of the to-spec hack is never
+// trimmed.  Segments are recounted when the display changes frames
+// and every 16 semiticks otherwise.  A CRITICAL_PROFILE build prints
+// the lit segment count and OCR0A with each table dump, for tuning.
+//
+//
+// #define BOOST_LOAD_TRIM 25
+
 
 // DISPLAY MULTIPLEXING ALGORITHM
 //
@@ -252,6 +299,30 @@
 // #define SEGMENT_MULTIPLEXING
 
 
+// ADAPTIVE MULTIPLEXING RATE
+//
+// Multiplexing flicker is hardest to see when the display is dim.
+// Defining ADAPTIVE_MULTIPLEX_RATE lowers the multiplexing rate (and
+// so the number of MAX6921 updates) while the display brightness is
+// at or below ADAPTIVE_MULTIPLEX_LEVEL, which, with the automatic
+// dimmer, is also when the room is dark.  The normal rate returns
+// as soon as any button is pressed and holds until the display-off
+// timer expires a minute later.
+//
+// ADAPTIVE_MULTIPLEX_LEVEL is a brightness level from 0 to 10 (as in
+// the brightness menu) and defaults to 2.  ADAPTIVE_MULTIPLEX_TIME
+// is the longest allowed time to display all digits once, in units
+// of 32 microseconds, and defaults to 512 (about 60 Hz).  Shorter
+// times flicker less.
+//
+// This feature is not available with segment multiplexing.
+//
+//
+// #define ADAPTIVE_MULTIPLEX_RATE
+// #define ADAPTIVE_MULTIPLEX_LEVEL 2
+// #define ADAPTIVE_MULTIPLEX_TIME 512
+
+
 // IV-18 TO-SPEC HACK
 //
 // The Adafruit Ice Tube Clock v1.1 does not drive the IV-18 VFD tube
@@ -316,7 +387,9 @@
 //
 // Although not to-spec, a sure-fire way to eliminate hum is to simply
 // drive the filament with DC.  With a high boost voltage, there
-// should not be a noticeable brightness gradient.
+// should not be a noticeable brightness gradient.  Full-voltage
+// DC also frees the timer0 overflow interrupt from stepping the
+// filament, so most overflows take the short path in icetube.c.
 //
 // Defining the FILAMENT_DRIVE_DC_FWD macro will drive the display
 // with direct current instead of alternating current.  Current will
@@ -405,6 +478,29 @@
 // #define AUTODRIFT_CONSTANT 0
 
 
+// LEAST-SQUARES DRIFT ESTIMATION
+//
+// By default, each time correction yields a single drift estimate,
+// and the clock uses the median of the last several estimates.  Time
+// corrections that are too small or too large are discarded.
+//
+// Defining the AUTODRIFT_LEAST_SQUARES macro instead fits the drift
+// rate to the last several time corrections, weighting each by the
+// length of the interval over which the error accumulated.  Small
+// corrections made after a long interval are no longer discarded, so
+// the clock should converge on an accurate drift correction after
+// fewer time sets.  The fit is computed in fixed-point arithmetic.
+//
+// With this option, the clock also estimates the uncertainty of its
+// drift correction.  The half-width of a ~95% confidence interval is
+// available in time.drift_confidence in units of ppb (parts per
+// billion).  Larger values indicate that the clock needs more time
+// corrections to determine its drift.
+//
+//
+// #define AUTODRIFT_LEAST_SQUARES
+
+
 // SLEEP DRIFT CORRECTION VALUE
 //
 // At lower voltages, oscillator circuits tend to operate at lower
@@ -417,6 +513,37 @@
 #define AUTODRIFT_SLEEP 2600  // ~3 ppm
 
 
+// PACKED-BCD TIME DISPLAY
+//
+// Defining TIME_BCD keeps packed-BCD copies of the hour, minute, and
+// second (e.g. 0x59 for 59) alongside the binary time.  The copies
+// are advanced every second with decimal carries, and the time
+// display draws digits straight from the nibbles, so the time
+// display needs no division by ten each second.  This costs three
+// bytes of RAM and a little program memory.
+//
+//
+// #define TIME_BCD
+
+
+// STREAMING MARQUEE
+//
+// Defining DISPLAY_MARQUEE adds display_marquee_pstr() and
+// display_marquee_str(), which scroll a program memory or RAM string
+// of any length leftward across the display.  Each step shifts the
+// display one position and draws only the next character, so no
+// buffer the size of the message is needed.  DISPLAY_MARQUEE_DELAY
+// sets the time for each step in semiticks (192 by default, at most
+// 255).  With a marquee, the low battery, lost gps signal, and
+// temperature sensor error messages scroll by in full every
+// MODE_MARQUEE_INTERVAL seconds instead of replacing the time on odd
+// seconds; the time display is suspended while a marquee scrolls.
+//
+//
+// #define DISPLAY_MARQUEE
+// #define DISPLAY_MARQUEE_DELAY 192
+
+
 // DEBUGGING FEATURES
 //
 // The following macro enables debugging.  When enabled, debugging
@@ -427,5 +554,18 @@
 //
 // #define DEBUG
 
+// The following macro enables profiling of atomic blocks, which
+// mask interrupts (including display multiplexing).  Every
+// ATOMIC_BLOCK records how often it was entered and the longest
+// time it masked interrupts in system clock cycles; the table is
+// transmitted over USART every minute (see profile.c).  Profiling
+// requires DEBUG and adds overhead to every atomic block.  The table
+// holds PROFILE_SITES blocks (32 by default, 13 bytes of RAM each),
+// fewer than the firmware contains; entries into blocks left out of
+// a full table are reported as missed, and PROFILE_SITES may be
+// raised if RAM allows.
+//
+// #define CRITICAL_PROFILE
+
 
 #endif  // CONFIG_H